@@ -0,0 +1,226 @@
+/*
+ * adc.c
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * ADC sampling triggered by timer 1, packing 8 bit samples into radio payloads.
+ */
+
+#include "adc.h"
+#include "clock.h"
+
+#ifndef F_CPU				// if F_CPU was not defined in Project -> Properties
+#define F_CPU 1000000UL		// define it now as 1 MHz unsigned long
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+// AVCC reference, left adjusted for 8 bit results in ADCH.
+#define ADMUX_AVCC			0x40
+#define ADMUX_8_BITS		0x20
+
+// the ADC is clocked between 50 and 200 kHz.
+#if F_CPU <= 1600000UL
+#define ADC_DIVIDER			8
+#define ADC_PRESCALER_BITS	0x03
+#elif F_CPU <= 12800000UL
+#define ADC_DIVIDER			64
+#define ADC_PRESCALER_BITS	0x06
+#else
+#define ADC_DIVIDER			128
+#define ADC_PRESCALER_BITS	0x07
+#endif
+
+// an auto triggered conversion takes 13.5 ADC clocks.
+#define ADC_MAX_RATE		(F_CPU / ADC_DIVIDER / 14)
+
+// auto trigger source, timer/counter 1 compare match B.
+#define ADTS_TIMER1_COMPB	((1 << ADTS2) | (1 << ADTS0))
+
+// samples are packed into one buffer while the other waits to be sent.
+static uint8_t m_buffer[2][32];
+static volatile uint8_t m_ready[2];
+static volatile uint8_t m_fill = 0;
+static volatile uint8_t m_count = 0;
+static volatile uint8_t m_sequence = 0;
+static volatile uint16_t m_overruns = 0;
+static uint8_t m_samples = ADC_MAX_SAMPLES;
+static adc_ready_callback_t m_ready_callback = 0;
+
+// function declarations.
+void hand_over();
+
+// routine for the ADC conversion complete interrupt.
+ISR(ADC_vect)
+{
+	// the trigger is the rising edge of OCF1B, so it must be cleared for the next one.
+	TIFR1 = (1 << OCF1B);
+
+	uint8_t sample = ADCH;
+
+	// both buffers are full.
+	if (m_count == m_samples)
+	{
+		m_overruns++;
+		return;
+	}
+
+	uint8_t * packet = m_buffer[m_fill];
+
+	if (m_count == 0)
+	{
+		uint16_t time = clock_millis() & 0x0FFF;
+
+		packet[0] = time & 0xFF;
+		packet[1] = (m_sequence << 4) | (time >> 8);
+		m_sequence = (m_sequence + 1) & 0x0F;
+	}
+
+	packet[ADC_HEADER_SIZE + m_count] = sample;
+	m_count++;
+
+	if (m_count == m_samples)
+		hand_over();
+}
+
+// start sampling an ADC channel at the given rate, the samples are packed into packets of the given size.
+// requires clock_init(), returns 0 if the rate or samples are not valid.
+uint8_t adc_start(uint8_t const channel, uint16_t const rate_hz, uint8_t const samples)
+{
+	if (channel > 7 || rate_hz == 0 || rate_hz > ADC_MAX_RATE || samples == 0 || samples > ADC_MAX_SAMPLES)
+		return 0;
+
+	// timer 1 counts to OCR1A, with the smallest prescaler that fits.
+	uint32_t ticks = F_CPU / rate_hz;
+	uint8_t cs = (1 << CS10);
+
+	if (ticks > 65536UL)
+	{
+		ticks /= 8;
+		cs = (1 << CS11);
+	}
+
+	if (ticks > 65536UL)
+	{
+		ticks /= 8;
+		cs = (1 << CS11) | (1 << CS10);
+	}
+
+	if (ticks > 65536UL)
+		return 0;
+
+	adc_stop();
+
+	uint8_t sreg = SREG;
+	cli();
+
+	m_samples = samples;
+	m_ready[0] = 0;
+	m_ready[1] = 0;
+	m_fill = 0;
+	m_count = 0;
+	m_sequence = 0;
+	m_overruns = 0;
+
+	// the digital input buffer is not needed on an analogue pin.
+	DIDR0 |= (1 << channel);
+
+	ADMUX = ADMUX_AVCC | ADMUX_8_BITS | channel;
+	ADCSRB = ADTS_TIMER1_COMPB;
+	ADCSRA = (1 << ADEN) | (1 << ADATE) | (1 << ADIE) | ADC_PRESCALER_BITS;
+
+	// clear timer on compare match (CTC) mode, compare match B at the top of the count.
+	TCCR1A = 0;
+	TCNT1 = 0;
+	OCR1A = ticks - 1;
+	OCR1B = ticks - 1;
+	TIFR1 = (1 << OCF1B);
+	TCCR1B = (1 << WGM12) | cs;
+
+	SREG = sreg;
+
+	return 1;
+}
+
+// stop sampling, a full packet waiting is kept.
+void adc_stop()
+{
+	TCCR1B = 0;
+	ADCSRA &= ~((1 << ADATE) | (1 << ADIE));
+
+	// drop the samples of a partly filled packet.
+	uint8_t sreg = SREG;
+	cli();
+
+	if (m_count != m_samples)
+		m_count = 0;
+
+	SREG = sreg;
+}
+
+// returns a full packet and its size, or 0 if there is none.
+// the packet stays in its buffer until adc_release() is called.
+uint8_t const * adc_packet(uint8_t * size)
+{
+	// the buffer being filled only changes once the other one has been released.
+	uint8_t other = m_fill ^ 1;
+
+	if (!m_ready[other])
+		return 0;
+
+	*size = ADC_HEADER_SIZE + m_samples;
+	return m_buffer[other];
+}
+
+// release the packet returned by adc_packet().
+void adc_release()
+{
+	uint8_t sreg = SREG;
+	cli();
+
+	m_ready[m_fill ^ 1] = 0;
+
+	// a full buffer held back by the released one can now be passed on.
+	if (m_count == m_samples)
+		hand_over();
+
+	SREG = sreg;
+}
+
+// set the function called when a packet is full, 0 for none.
+// it may be called from the ADC interrupt or from adc_release(), with interrupts disabled.
+void adc_set_ready_callback(adc_ready_callback_t callback)
+{
+	m_ready_callback = callback;
+}
+
+// returns the number of samples dropped because both buffers were full.
+uint16_t adc_overruns()
+{
+	uint8_t sreg = SREG;
+	cli();
+	uint16_t overruns = m_overruns;
+	SREG = sreg;
+
+	return overruns;
+}
+
+// private functions...
+//
+
+// pass the full buffer on and start filling the other one, if it has been released.
+// called with interrupts disabled.
+void hand_over()
+{
+	if (m_ready[m_fill ^ 1])
+		return;
+
+	m_ready[m_fill] = 1;
+	m_fill ^= 1;
+	m_count = 0;
+
+	if (m_ready_callback != 0)
+		m_ready_callback();
+}
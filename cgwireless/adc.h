@@ -0,0 +1,52 @@
+/*
+ * adc.h
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * ADC sampling triggered by timer 1, packing 8 bit samples into radio payloads.
+ */
+
+#include <stdint.h>
+
+#ifndef ADC_H_
+#define ADC_H_
+
+// a packet starts with a 16 bit header, the top 4 bits hold a sequence number
+// and the low 12 bits the clock_millis() time of the first sample.
+#define ADC_HEADER_SIZE 2
+
+// largest number of samples in a packet.
+#define ADC_MAX_SAMPLES (32 - ADC_HEADER_SIZE)
+
+// sequence number of a packet.
+#define ADC_PACKET_SEQUENCE(packet) ((packet)[1] >> 4)
+
+// time of the first sample of a packet, in milliseconds modulo 4096.
+#define ADC_PACKET_TIME(packet) ((((uint16_t)(packet)[1] & 0x0F) << 8) | (packet)[0])
+
+// called from the ADC interrupt when a packet is full.
+typedef void (*adc_ready_callback_t)();
+
+// start sampling an ADC channel at the given rate, the samples are packed into packets of the given size.
+// requires clock_init(), returns 0 if the rate or samples are not valid.
+uint8_t adc_start(uint8_t const channel, uint16_t const rate_hz, uint8_t const samples);
+
+// stop sampling, a full packet waiting is kept.
+void adc_stop();
+
+// returns a full packet and its size, or 0 if there is none.
+// the packet stays in its buffer until adc_release() is called.
+uint8_t const * adc_packet(uint8_t * size);
+
+// release the packet returned by adc_packet().
+void adc_release();
+
+// set the function called when a packet is full, 0 for none.
+// it may be called from the ADC interrupt or from adc_release(), with interrupts disabled.
+void adc_set_ready_callback(adc_ready_callback_t callback);
+
+// returns the number of samples dropped because both buffers were full.
+uint16_t adc_overruns();
+
+#endif /* ADC_H_ */
@@ -0,0 +1,348 @@
+/*
+ * cgarq.c
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Selective repeat ARQ, reliable delivery over unacknowledged transmits.
+ */
+
+#include "cgarq.h"
+#include "cgrf.h"
+#include "clock.h"
+#include "nrf24l01.h"
+#include <string.h>
+
+// frame types.
+#define FRAME_DATA			0x01
+#define FRAME_ACK			0x02
+
+// acknowledgment payload, type, next sequence number expected and a bitmap of the frames received after it.
+#define ACK_SIZE			3
+
+#define SLOT_MASK			(CGARQ_MAX_WINDOW - 1)
+
+typedef enum
+{
+	slot_free,
+	slot_queued,		// waiting for its first send.
+	slot_resend,		// lost, waiting to be sent again.
+	slot_sent,			// waiting for an acknowledgment.
+	slot_acked,
+} slot_state_t;
+
+typedef struct
+{
+	slot_state_t state;
+	uint8_t size;
+	uint8_t data[CGARQ_DATA_SIZE];
+} arq_slot_t;
+
+static uint8_t m_window = CGARQ_MAX_WINDOW;
+static uint8_t m_poll_every = 1;
+static cgarq_stats_t m_stats;
+
+// transmitter, frames from m_base up to m_next are in the window.
+static arq_slot_t m_tx[CGARQ_MAX_WINDOW];
+static uint8_t m_base = 0;
+static uint8_t m_next = 0;
+static uint8_t m_since_poll = 0;
+static uint8_t m_in_flight = 0;
+static uint8_t m_flight_seq = 0;
+static uint8_t m_flight_poll = 0;
+static uint32_t m_last_poll = 0;
+
+// receiver, frames held until every frame before them has been delivered.
+static arq_slot_t m_rx[CGARQ_MAX_WINDOW];
+static uint8_t m_expected = 0;
+static cgrf_rx_callback_t m_deliver = 0;
+
+// frames have been received since the acknowledgment payload was loaded.
+static uint8_t m_ack_stale = 0;
+static uint8_t m_ack_pipe = 0;
+
+// function declarations.
+void transmit_frame(uint8_t const seq, uint8_t const poll);
+void arq_acknowledged(uint8_t const pipe, uint8_t const * const data, uint8_t const size);
+void advance_base();
+void refresh_acknowledgment(uint8_t const pipe);
+
+// start selective repeat on either end, both ends must use the same window.
+// frames are sent without acknowledgment, every poll_every frame is sent with one and the receiver's
+// cumulative and bitmap acknowledgment comes back in its acknowledgment payload.
+// turns auto acknowledgment on, and takes over the acknowledgment payloads of the receiver.
+// requires clock_init(), returns 0 if the window is not valid.
+uint8_t cgarq_init(uint8_t const window, uint8_t const poll_every)
+{
+	if (window == 0 || window > CGARQ_MAX_WINDOW || poll_every == 0)
+		return 0;
+
+	m_window = window;
+	m_poll_every = poll_every;
+
+	memset(m_tx, 0, sizeof(m_tx));
+	memset(m_rx, 0, sizeof(m_rx));
+	memset(&m_stats, 0, sizeof(m_stats));
+
+	m_base = 0;
+	m_next = 0;
+	m_since_poll = 0;
+	m_in_flight = 0;
+	m_expected = 0;
+	m_ack_stale = 0;
+	m_last_poll = clock_millis();
+
+	// polls need an acknowledgment and the acknowledgment payload carries the receiver's state.
+	cgrf_set_acknowledgment(auto_acknowledgment);
+	cgrf_set_ack_payload_callback(arq_acknowledged);
+
+	return 1;
+}
+
+// queue a frame of up to CGARQ_DATA_SIZE bytes, returns 0 if the window is full.
+uint8_t cgarq_send(uint8_t const * const data, uint8_t const size)
+{
+	if (size == 0 || size > CGARQ_DATA_SIZE)
+		return 0;
+
+	if ((uint8_t)(m_next - m_base) >= m_window)
+		return 0;
+
+	arq_slot_t * slot = &m_tx[m_next & SLOT_MASK];
+	memcpy(slot->data, data, size);
+	slot->size = size;
+	slot->state = slot_queued;
+	m_next++;
+
+	return 1;
+}
+
+// send, resend and poll, call from the transmitter's main loop.
+void cgarq_update()
+{
+	if (m_in_flight)
+	{
+		// the acknowledgment payload of a poll is handled inside cgrf_poll().
+		cgrf_send_report_t const * report = cgrf_poll();
+
+		if (report->result == send_in_progress)
+			return;
+
+		m_in_flight = 0;
+		arq_slot_t * slot = &m_tx[m_flight_seq & SLOT_MASK];
+
+		if (report->result != send_success)
+			slot->state = slot_resend;
+		else if (m_flight_poll)
+			slot->state = slot_acked;
+
+		advance_base();
+	}
+
+	uint8_t outstanding = m_next - m_base;
+	uint8_t first = outstanding;
+	uint8_t waiting = 0;
+
+	// the oldest frame waiting to be sent, and how many are waiting.
+	for (uint8_t i = 0; i < outstanding; i++)
+	{
+		slot_state_t state = m_tx[(uint8_t)(m_base + i) & SLOT_MASK].state;
+
+		if (state == slot_queued || state == slot_resend)
+		{
+			if (waiting == 0)
+				first = i;
+
+			waiting++;
+		}
+	}
+
+	if (waiting != 0)
+	{
+		// poll every few frames, and with the last frame once the window is full.
+		m_since_poll++;
+		uint8_t poll = (m_since_poll >= m_poll_every) || (waiting == 1 && outstanding == m_window);
+
+		transmit_frame(m_base + first, poll);
+	}
+	else if (outstanding != 0 && clock_elapsed(m_last_poll) >= CGARQ_POLL_MS)
+	{
+		// nothing left to send, poll with the oldest frame not acknowledged.
+		transmit_frame(m_base, 1);
+	}
+}
+
+// returns the number of frames not yet acknowledged.
+uint8_t cgarq_pending()
+{
+	return m_next - m_base;
+}
+
+// set the function called on the receiver for each frame, in order, 0 for none.
+void cgarq_set_deliver_callback(cgrf_rx_callback_t callback)
+{
+	m_deliver = callback;
+}
+
+// pass a received payload to the receiver, can be given to cgrf_drain_rx() as its callback.
+void cgarq_receive(uint8_t const pipe, uint8_t const * const data, uint8_t const size)
+{
+	if (size <= CGARQ_HEADER_SIZE || data[0] != FRAME_DATA)
+		return;
+
+	uint8_t seq = data[1];
+
+	if ((uint8_t)(seq - m_expected) >= m_window)
+	{
+		// already delivered, the acknowledgment that covered it was lost.
+		m_stats.duplicates++;
+	}
+	else
+	{
+		arq_slot_t * slot = &m_rx[seq & SLOT_MASK];
+
+		if (slot->state != slot_free)
+		{
+			m_stats.duplicates++;
+		}
+		else
+		{
+			slot->size = size - CGARQ_HEADER_SIZE;
+			memcpy(slot->data, &data[CGARQ_HEADER_SIZE], slot->size);
+			slot->state = slot_queued;
+		}
+
+		// deliver every frame that is now in order.
+		slot = &m_rx[m_expected & SLOT_MASK];
+
+		while (slot->state != slot_free)
+		{
+			if (m_deliver != 0)
+				m_deliver(pipe, slot->data, slot->size);
+
+			slot->state = slot_free;
+			m_stats.delivered++;
+			m_expected++;
+			slot = &m_rx[m_expected & SLOT_MASK];
+		}
+	}
+
+	// the acknowledgment payload is replaced once the RX FIFO has been emptied, in cgarq_acknowledge().
+	m_ack_stale = 1;
+	m_ack_pipe = pipe;
+}
+
+// load the receiver's state into the acknowledgment payload if frames have been received since it was loaded.
+// call after each cgrf_drain_rx(), so the state includes every frame that was waiting in the RX FIFO.
+void cgarq_acknowledge()
+{
+	if (!m_ack_stale)
+		return;
+
+	m_ack_stale = 0;
+	refresh_acknowledgment(m_ack_pipe);
+}
+
+// get the ARQ counters.
+void cgarq_get_stats(cgarq_stats_t * stats)
+{
+	*stats = m_stats;
+}
+
+// private functions...
+//
+
+// send a frame in the window, with an acknowledgment when it is a poll.
+void transmit_frame(uint8_t const seq, uint8_t const poll)
+{
+	arq_slot_t * slot = &m_tx[seq & SLOT_MASK];
+	uint8_t buffer[32];
+
+	buffer[0] = FRAME_DATA;
+	buffer[1] = seq;
+	memcpy(&buffer[CGARQ_HEADER_SIZE], slot->data, slot->size);
+
+	if (cgrf_send_async(&buffer[0], CGARQ_HEADER_SIZE + slot->size, poll ? delivery_acknowledged : delivery_unacknowledged) == 0)
+		return;
+
+	if (slot->state == slot_queued)
+		m_stats.sent++;
+	else
+		m_stats.retransmitted++;
+
+	slot->state = slot_sent;
+	m_in_flight = 1;
+	m_flight_seq = seq;
+	m_flight_poll = poll;
+
+	if (poll)
+	{
+		m_since_poll = 0;
+		m_last_poll = clock_millis();
+		m_stats.polls++;
+	}
+}
+
+// the receiver's state came back in the acknowledgment payload of a poll.
+// every frame sent before the poll that it does not show as received is sent again. the state was loaded
+// after the receiver's last drain, so frames still in its RX FIFO then are resent and dropped as duplicates.
+void arq_acknowledged(uint8_t const pipe, uint8_t const * const data, uint8_t const size)
+{
+	if (size < ACK_SIZE || data[0] != FRAME_ACK || !m_in_flight || !m_flight_poll)
+		return;
+
+	uint8_t outstanding = m_next - m_base;
+	uint8_t cumulative = data[1] - m_base;
+	uint8_t bitmap = data[2];
+
+	// an acknowledgment older than the window.
+	if (cumulative > outstanding)
+		return;
+
+	for (uint8_t i = 0; i < outstanding; i++)
+	{
+		uint8_t seq = m_base + i;
+		arq_slot_t * slot = &m_tx[seq & SLOT_MASK];
+
+		if (slot->state != slot_sent || seq == m_flight_seq)
+			continue;
+
+		uint8_t received = (i < cumulative) || (i > cumulative && i - cumulative <= 8 && (bitmap & (1 << (i - cumulative - 1))));
+
+		slot->state = received ? slot_acked : slot_resend;
+	}
+}
+
+// free the acknowledged frames at the start of the window.
+void advance_base()
+{
+	arq_slot_t * slot = &m_tx[m_base & SLOT_MASK];
+
+	while (m_base != m_next && slot->state == slot_acked)
+	{
+		slot->state = slot_free;
+		m_base++;
+		slot = &m_tx[m_base & SLOT_MASK];
+	}
+}
+
+// replace the acknowledgment payload with the receiver's current state.
+void refresh_acknowledgment(uint8_t const pipe)
+{
+	uint8_t ack[ACK_SIZE];
+	uint8_t bitmap = 0;
+
+	for (uint8_t i = 0; i < 8 && i + 1 < m_window; i++)
+	{
+		if (m_rx[(uint8_t)(m_expected + 1 + i) & SLOT_MASK].state != slot_free)
+			bitmap |= (1 << i);
+	}
+
+	ack[0] = FRAME_ACK;
+	ack[1] = m_expected;
+	ack[2] = bitmap;
+
+	// a loaded payload cannot be replaced, only flushed.
+	nrf24_flush_tx();
+	nrf24_load_ack_payload(pipe, &ack[0], ACK_SIZE);
+}
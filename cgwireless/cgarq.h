@@ -0,0 +1,67 @@
+/*
+ * cgarq.h
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Selective repeat ARQ, reliable delivery over unacknowledged transmits.
+ */
+
+#include <stdint.h>
+#include "cgrf.h"
+
+#ifndef CGARQ_H_
+#define CGARQ_H_
+
+// largest number of frames outstanding, a power of 2 no greater than 8.
+#define CGARQ_MAX_WINDOW 8
+
+// each frame starts with its type and sequence number.
+#define CGARQ_HEADER_SIZE 2
+
+// application bytes carried by a frame.
+#define CGARQ_DATA_SIZE (32 - CGARQ_HEADER_SIZE)
+
+// milliseconds between polls while frames are waiting to be acknowledged.
+#define CGARQ_POLL_MS 20
+
+// ARQ counters.
+typedef struct
+{
+	uint16_t sent;
+	uint16_t retransmitted;
+	uint16_t polls;
+	uint16_t delivered;		// frames delivered in order on the receiver.
+	uint16_t duplicates;
+} cgarq_stats_t;
+
+// start selective repeat on either end, both ends must use the same window.
+// frames are sent without acknowledgment, every poll_every frame is sent with one and the receiver's
+// cumulative and bitmap acknowledgment comes back in its acknowledgment payload.
+// turns auto acknowledgment on, and takes over the acknowledgment payloads of the receiver.
+// requires clock_init(), returns 0 if the window is not valid.
+uint8_t cgarq_init(uint8_t const window, uint8_t const poll_every);
+
+// queue a frame of up to CGARQ_DATA_SIZE bytes, returns 0 if the window is full.
+uint8_t cgarq_send(uint8_t const * const data, uint8_t const size);
+
+// send, resend and poll, call from the transmitter's main loop.
+void cgarq_update();
+
+// returns the number of frames not yet acknowledged.
+uint8_t cgarq_pending();
+
+// set the function called on the receiver for each frame, in order, 0 for none.
+void cgarq_set_deliver_callback(cgrf_rx_callback_t callback);
+
+// pass a received payload to the receiver, can be given to cgrf_drain_rx() as its callback.
+void cgarq_receive(uint8_t const pipe, uint8_t const * const data, uint8_t const size);
+
+// load the receiver's state into the acknowledgment payload if frames have been received since it was loaded.
+// call after each cgrf_drain_rx(), so the state includes every frame that was waiting in the RX FIFO.
+void cgarq_acknowledge();
+
+// get the ARQ counters.
+void cgarq_get_stats(cgarq_stats_t * stats);
+
+#endif /* CGARQ_H_ */
@@ -0,0 +1,231 @@
+/*
+ * cgfrag.c
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Fragmentation and reassembly of messages larger than one 32 byte payload.
+ */
+
+#include "cgfrag.h"
+#include "cgrf.h"
+#include "clock.h"
+#include <string.h>
+#include <util/crc16.h>
+
+// sender state.
+static uint8_t m_next_id = 0;
+
+// reassembly of one message at a time, with a bit per fragment received.
+static uint8_t m_buffer[CGFRAG_MAX_MESSAGE + 2];
+static uint8_t m_received[(CGFRAG_MAX_FRAGMENTS + 7) / 8];
+static uint8_t m_active = 0;
+static uint8_t m_complete = 0;
+static uint8_t m_id = 0;
+static uint8_t m_pipe = 0;
+static uint8_t m_count = 0;
+static uint8_t m_remaining = 0;
+static uint16_t m_size = 0;
+static uint32_t m_last = 0;
+static cgfrag_stats_t m_stats;
+
+// function declarations.
+uint16_t message_crc(uint8_t const * const data, uint16_t const size);
+void start_message(uint8_t const pipe, uint8_t const id, uint8_t const count);
+void finish_message();
+
+// send a message of up to CGFRAG_MAX_MESSAGE bytes as numbered fragments on a transmit stream.
+// needs dynamic payload length, returns 0 if the message was too large, the radio was not a powered up
+// transmitter or a fragment was not delivered.
+uint8_t cgfrag_send(uint8_t const * const data, uint16_t const size, delivery_t const delivery)
+{
+	if (size == 0 || size > CGFRAG_MAX_MESSAGE)
+		return 0;
+
+	uint16_t crc = message_crc(data, size);
+	uint16_t total = size + 2;
+	uint8_t count = (total + CGFRAG_DATA_SIZE - 1) / CGFRAG_DATA_SIZE;
+	uint8_t buffer[32];
+	uint16_t offset = 0;
+
+	// fragments are queued back to back, the TX FIFO keeps up to three in flight.
+	if (!cgrf_stream_begin(delivery))
+		return 0;
+
+	for (uint8_t index = 0; index < count; index++)
+	{
+		buffer[0] = m_next_id;
+		buffer[1] = index;
+		buffer[2] = count;
+
+		uint8_t n = 0;
+
+		while (n < CGFRAG_DATA_SIZE && offset < total)
+		{
+			if (offset < size)
+				buffer[CGFRAG_HEADER_SIZE + n] = data[offset];
+			else if (offset == size)
+				buffer[CGFRAG_HEADER_SIZE + n] = crc & 0xFF;
+			else
+				buffer[CGFRAG_HEADER_SIZE + n] = crc >> 8;
+
+			n++;
+			offset++;
+		}
+
+		while (!cgrf_stream_push(&buffer[0], CGFRAG_HEADER_SIZE + n))
+			;
+	}
+
+	cgrf_stream_t result;
+	cgrf_stream_end(&result);
+
+	m_next_id++;
+
+	return result.failed == 0;
+}
+
+// pass a received payload to reassembly, can be given to cgrf_drain_rx() as its callback.
+void cgfrag_receive(uint8_t const pipe, uint8_t const * const data, uint8_t const size)
+{
+	// a complete message holds the buffer until it is released.
+	if (size <= CGFRAG_HEADER_SIZE || m_complete)
+	{
+		m_stats.dropped++;
+		return;
+	}
+
+	uint8_t id = data[0];
+	uint8_t index = data[1];
+	uint8_t count = data[2];
+	uint8_t n = size - CGFRAG_HEADER_SIZE;
+
+	if (count == 0 || count > CGFRAG_MAX_FRAGMENTS || index >= count)
+	{
+		m_stats.dropped++;
+		return;
+	}
+
+	// one message at a time, another node waits for its timeout.
+	if (m_active && pipe != m_pipe)
+	{
+		m_stats.dropped++;
+		return;
+	}
+
+	if (!m_active || id != m_id || count != m_count)
+		start_message(pipe, id, count);
+
+	uint8_t bit = 1 << (index & 0x07);
+
+	// a repeated fragment.
+	if (m_received[index >> 3] & bit)
+		return;
+
+	// every fragment but the last is full.
+	uint16_t offset = (uint16_t)index * CGFRAG_DATA_SIZE;
+
+	if ((index != count - 1 && n != CGFRAG_DATA_SIZE) || offset + n > sizeof(m_buffer))
+	{
+		m_stats.dropped++;
+		return;
+	}
+
+	memcpy(&m_buffer[offset], &data[CGFRAG_HEADER_SIZE], n);
+	m_received[index >> 3] |= bit;
+	m_last = clock_millis();
+
+	if (index == count - 1)
+		m_size = offset + n;
+
+	if (--m_remaining == 0)
+		finish_message();
+}
+
+// abandon an incomplete message that has timed out, call from the main loop.
+// requires clock_init().
+void cgfrag_update()
+{
+	if (m_active && clock_elapsed(m_last) >= CGFRAG_TIMEOUT_MS)
+	{
+		m_active = 0;
+		m_stats.timeouts++;
+	}
+}
+
+// returns the complete message and its size, or 0 if there is none.
+// the message stays in the buffer until cgfrag_release() is called.
+uint8_t const * cgfrag_message(uint16_t * size)
+{
+	if (!m_complete)
+		return 0;
+
+	*size = m_size - 2;
+	return &m_buffer[0];
+}
+
+// release the complete message, freeing the buffer for the next one.
+void cgfrag_release()
+{
+	m_complete = 0;
+}
+
+// get the reassembly counters.
+void cgfrag_get_stats(cgfrag_stats_t * stats)
+{
+	*stats = m_stats;
+}
+
+// private functions...
+//
+
+// CRC-16 CCITT of the message.
+uint16_t message_crc(uint8_t const * const data, uint16_t const size)
+{
+	uint16_t crc = 0xFFFF;
+
+	for (uint16_t i = 0; i < size; i++)
+		crc = _crc_ccitt_update(crc, data[i]);
+
+	return crc;
+}
+
+// start reassembling a new message, abandoning any incomplete one.
+void start_message(uint8_t const pipe, uint8_t const id, uint8_t const count)
+{
+	if (m_active)
+		m_stats.dropped++;
+
+	memset(m_received, 0, sizeof(m_received));
+
+	m_active = 1;
+	m_id = id;
+	m_pipe = pipe;
+	m_count = count;
+	m_remaining = count;
+	m_size = 0;
+}
+
+// check the CRC-16 of a message with every fragment received.
+void finish_message()
+{
+	m_active = 0;
+
+	if (m_size < 3)
+	{
+		m_stats.crc_errors++;
+		return;
+	}
+
+	uint16_t size = m_size - 2;
+	uint16_t crc = m_buffer[size] | ((uint16_t)m_buffer[size + 1] << 8);
+
+	if (crc != message_crc(&m_buffer[0], size))
+	{
+		m_stats.crc_errors++;
+		return;
+	}
+
+	m_complete = 1;
+	m_stats.messages++;
+}
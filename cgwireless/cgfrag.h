@@ -0,0 +1,63 @@
+/*
+ * cgfrag.h
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Fragmentation and reassembly of messages larger than one 32 byte payload.
+ */
+
+#include <stdint.h>
+#include "cgrf.h"
+
+#ifndef CGFRAG_H_
+#define CGFRAG_H_
+
+// largest message, bounded by the reassembly buffer.
+// 255 fragments allow up to 7393 bytes on a part with the SRAM for it.
+#define CGFRAG_MAX_MESSAGE 512
+
+// each fragment starts with the message id, the fragment index and the fragment count.
+#define CGFRAG_HEADER_SIZE 3
+
+// message bytes carried by a fragment, the CRC-16 follows the last message byte.
+#define CGFRAG_DATA_SIZE (32 - CGFRAG_HEADER_SIZE)
+
+// fragments in the largest message, including its CRC-16.
+#define CGFRAG_MAX_FRAGMENTS ((CGFRAG_MAX_MESSAGE + 2 + CGFRAG_DATA_SIZE - 1) / CGFRAG_DATA_SIZE)
+
+// milliseconds without a fragment before an incomplete message is abandoned.
+#define CGFRAG_TIMEOUT_MS 200
+
+// reassembly counters.
+typedef struct
+{
+	uint16_t messages;
+	uint16_t crc_errors;
+	uint16_t timeouts;
+	uint16_t dropped;		// fragments that could not be used.
+} cgfrag_stats_t;
+
+// send a message of up to CGFRAG_MAX_MESSAGE bytes as numbered fragments on a transmit stream.
+// needs dynamic payload length, returns 0 if the message was too large, the radio was not a powered up
+// transmitter or a fragment was not delivered.
+uint8_t cgfrag_send(uint8_t const * const data, uint16_t const size, delivery_t const delivery);
+
+// pass a received payload to reassembly, can be given to cgrf_drain_rx() as its callback.
+void cgfrag_receive(uint8_t const pipe, uint8_t const * const data, uint8_t const size);
+
+// abandon an incomplete message that has timed out, call from the main loop.
+// requires clock_init().
+void cgfrag_update();
+
+// returns the complete message and its size, or 0 if there is none.
+// the message stays in the buffer until cgfrag_release() is called.
+uint8_t const * cgfrag_message(uint16_t * size);
+
+// release the complete message, freeing the buffer for the next one.
+void cgfrag_release();
+
+// get the reassembly counters.
+void cgfrag_get_stats(cgfrag_stats_t * stats);
+
+#endif /* CGFRAG_H_ */
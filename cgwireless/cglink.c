@@ -0,0 +1,235 @@
+/*
+ * cglink.c
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Link adaptation, steps the data rate, output power and auto retransmit
+ * settings of the transmitter from the outcome of its acknowledged sends.
+ */
+
+#include "cglink.h"
+#include "cgrf.h"
+#include "clock.h"
+#include "nrf24l01.h"
+#include <avr/pgmspace.h>
+
+// window entry bit for a failed send, the low bits hold the retransmits.
+#define WINDOW_FAILED		0x80
+#define WINDOW_RETRANSMITS	0x0F
+
+// number of data rates in the fallback schedule.
+#define SCHEDULE_SIZE		3
+
+typedef struct
+{
+	air_data_rate_t data_rate;
+	rf_output_power_t output_power;
+	uint8_t delay;		// auto retransmit delay, 250 us steps.
+	uint8_t count;		// auto retransmit count.
+} rung_t;
+
+// the ladder is ordered by the cost of a delivered byte on a clean channel,
+// each rung trades airtime and current for margin over the one before.
+// 250 kbps needs an auto retransmit delay of at least 1500 us for acknowledgment payloads.
+static rung_t const m_ladder[CGLINK_RUNGS] PROGMEM =
+{
+	{ data_rate_2_mbps,		power_minus_12dbm,	0,	3 },
+	{ data_rate_2_mbps,		power_minus_6dbm,	1,	5 },
+	{ data_rate_2_mbps,		power_0dbm,			1,	10 },
+	{ data_rate_1_mbps,		power_0dbm,			2,	15 },
+	{ data_rate_250_kbps,	power_0dbm,			5,	15 },
+};
+
+// the data rates a receiver cycles through when it hears nothing,
+// agreed with the transmitter so the link can always be found again.
+static air_data_rate_t const m_schedule[SCHEDULE_SIZE] PROGMEM =
+{
+	data_rate_2_mbps,
+	data_rate_1_mbps,
+	data_rate_250_kbps,
+};
+
+// transmitter state.
+static uint8_t m_window[CGLINK_WINDOW];
+static uint8_t m_next = 0;
+static uint8_t m_samples = 0;
+static uint8_t m_since_evaluate = 0;
+static uint8_t m_failure_run = 0;
+static uint8_t m_clean_windows = 0;
+static uint32_t m_changed = 0;
+static cglink_stats_t m_stats;
+
+// receiver state.
+static uint8_t m_follow = 0;
+static uint32_t m_heard = 0;
+
+// function declarations.
+void apply_rung(uint8_t const rung);
+void evaluate_window();
+
+// start link adaptation on the transmitter at the given rung.
+// requires clock_init().
+void cglink_init(uint8_t const rung)
+{
+	m_stats.changes = 0;
+	apply_rung((rung < CGLINK_RUNGS) ? rung : CGLINK_RUNGS - 1);
+}
+
+// record the outcome of an acknowledged send, may change the rung.
+// call from the send callback or with the report returned by cgrf_poll().
+void cglink_record(cgrf_send_report_t const * const report)
+{
+	if (report->result == send_idle || report->result == send_in_progress)
+		return;
+
+	// the receiver needs time to follow a rung change.
+	if (clock_elapsed(m_changed) < CGLINK_SETTLE_MS)
+		return;
+
+	uint8_t entry = report->retransmits & WINDOW_RETRANSMITS;
+
+	if (report->result == send_success)
+	{
+		m_failure_run = 0;
+	}
+	else
+	{
+		entry |= WINDOW_FAILED;
+		m_failure_run++;
+	}
+
+	if (m_failure_run >= CGLINK_LOST_LIMIT)
+	{
+		// the link is lost, wait on the most robust rung for the receiver to find it.
+		if (m_stats.rung != CGLINK_RUNGS - 1)
+			apply_rung(CGLINK_RUNGS - 1);
+		else
+			m_failure_run = 0;
+
+		return;
+	}
+
+	// slide the window, dropping the oldest outcome once it is full.
+	uint8_t slot = m_next & (CGLINK_WINDOW - 1);
+
+	if (m_samples == CGLINK_WINDOW)
+	{
+		if (m_window[slot] & WINDOW_FAILED)
+			m_stats.failures--;
+
+		m_stats.retransmits -= m_window[slot] & WINDOW_RETRANSMITS;
+	}
+	else
+	{
+		m_samples++;
+	}
+
+	m_window[slot] = entry;
+	m_next++;
+
+	if (entry & WINDOW_FAILED)
+		m_stats.failures++;
+
+	m_stats.retransmits += entry & WINDOW_RETRANSMITS;
+
+	// decide twice per window once it has filled.
+	m_since_evaluate++;
+
+	if (m_samples == CGLINK_WINDOW && m_since_evaluate >= CGLINK_WINDOW / 2)
+	{
+		m_since_evaluate = 0;
+		evaluate_window();
+	}
+}
+
+// get the link adaptation counters.
+void cglink_get_stats(cglink_stats_t * stats)
+{
+	*stats = m_stats;
+}
+
+// start following the transmitter's data rate on the receiver.
+// requires clock_init().
+void cglink_follow_init()
+{
+	m_follow = 0;
+	m_heard = clock_millis();
+
+	cgrf_set_data_rate(pgm_read_byte(&m_schedule[0]));
+}
+
+// tell the follower a frame has been received at the current data rate.
+void cglink_follow_frame()
+{
+	m_heard = clock_millis();
+}
+
+// move the receiver to the next data rate of the fallback schedule when nothing has been received.
+void cglink_follow_update()
+{
+	if (clock_elapsed(m_heard) < CGLINK_RX_DWELL_MS)
+		return;
+
+	m_follow++;
+
+	if (m_follow == SCHEDULE_SIZE)
+		m_follow = 0;
+
+	// registers must only be changed in standby.
+	nrf24_set_ce_low();
+	cgrf_set_data_rate(pgm_read_byte(&m_schedule[m_follow]));
+	cgrf_restore_ce();
+
+	m_heard = clock_millis();
+}
+
+// private functions...
+//
+
+// set the radio to a rung of the ladder and start a new window.
+void apply_rung(uint8_t const rung)
+{
+	rung_t const * entry = &m_ladder[rung];
+
+	cgrf_set_data_rate(pgm_read_byte(&entry->data_rate));
+	cgrf_set_output_power(pgm_read_byte(&entry->output_power));
+	cgrf_set_retransmit(pgm_read_byte(&entry->delay), pgm_read_byte(&entry->count));
+
+	m_stats.rung = rung;
+	m_stats.failures = 0;
+	m_stats.retransmits = 0;
+	m_stats.changes++;
+
+	m_next = 0;
+	m_samples = 0;
+	m_since_evaluate = 0;
+	m_failure_run = 0;
+	m_clean_windows = 0;
+	m_changed = clock_millis();
+}
+
+// step up to a more robust rung on a poor window,
+// or down to a cheaper rung after several clean windows in a row.
+void evaluate_window()
+{
+	if (m_stats.failures >= CGLINK_STEP_UP_FAILURES || m_stats.retransmits >= CGLINK_STEP_UP_RETRANSMITS)
+	{
+		m_clean_windows = 0;
+
+		if (m_stats.rung < CGLINK_RUNGS - 1)
+			apply_rung(m_stats.rung + 1);
+	}
+	else if (m_stats.failures == 0 && m_stats.retransmits <= CGLINK_STEP_DOWN_RETRANSMITS)
+	{
+		m_clean_windows++;
+
+		if (m_clean_windows >= CGLINK_STEP_DOWN_HOLD && m_stats.rung > 0)
+			apply_rung(m_stats.rung - 1);
+	}
+	else
+	{
+		// between the thresholds, hold the rung.
+		m_clean_windows = 0;
+	}
+}
@@ -0,0 +1,75 @@
+/*
+ * cglink.h
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Link adaptation, steps the data rate, output power and auto retransmit
+ * settings of the transmitter from the outcome of its acknowledged sends.
+ */
+
+#include <stdint.h>
+#include "cgrf.h"
+
+#ifndef CGLINK_H_
+#define CGLINK_H_
+
+// number of send outcomes in the sliding window.
+#define CGLINK_WINDOW 16
+
+// number of rungs on the ladder, rung 0 is the fastest and cheapest, the last rung the most robust.
+#define CGLINK_RUNGS 5
+
+// failed sends in the window that step up to a more robust rung.
+#define CGLINK_STEP_UP_FAILURES 2
+
+// retransmits in the window that step up to a more robust rung.
+#define CGLINK_STEP_UP_RETRANSMITS 24
+
+// retransmits in the window, with no failures, that allow a step down.
+#define CGLINK_STEP_DOWN_RETRANSMITS 2
+
+// clean windows in a row needed before stepping down.
+#define CGLINK_STEP_DOWN_HOLD 2
+
+// failed sends in a row taken as a lost link, the transmitter falls back to the last rung.
+#define CGLINK_LOST_LIMIT 8
+
+// milliseconds a following receiver waits on each data rate of the fallback schedule.
+#define CGLINK_RX_DWELL_MS 250
+
+// milliseconds after a rung change before outcomes are counted again,
+// long enough for a receiver to go once round the fallback schedule.
+#define CGLINK_SETTLE_MS (4 * CGLINK_RX_DWELL_MS)
+
+// link adaptation counters.
+typedef struct
+{
+	uint8_t rung;
+	uint8_t failures;		// failed sends in the window.
+	uint8_t retransmits;	// retransmits in the window.
+	uint16_t changes;		// rung changes since cglink_init().
+} cglink_stats_t;
+
+// start link adaptation on the transmitter at the given rung.
+// requires clock_init().
+void cglink_init(uint8_t const rung);
+
+// record the outcome of an acknowledged send, may change the rung.
+// call from the send callback or with the report returned by cgrf_poll().
+void cglink_record(cgrf_send_report_t const * const report);
+
+// get the link adaptation counters.
+void cglink_get_stats(cglink_stats_t * stats);
+
+// start following the transmitter's data rate on the receiver.
+// requires clock_init().
+void cglink_follow_init();
+
+// tell the follower a frame has been received at the current data rate.
+void cglink_follow_frame();
+
+// move the receiver to the next data rate of the fallback schedule when nothing has been received.
+void cglink_follow_update();
+
+#endif /* CGLINK_H_ */
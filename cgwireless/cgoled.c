@@ -13,6 +13,7 @@
  */
 
 #include "cgoled.h"
+#include "profile.h"
 #include <avr/io.h>
 
 #ifndef F_CPU				// if F_CPU was not defined in Project -> Properties
@@ -221,6 +222,8 @@ void oled_write_cmd_busy(uint8_t command, bool wait_for_bf)
 // Writes the given data to DDRAM or CGRAM.
 void oled_write_data(uint8_t data)
 {
+	PROFILE_START(profile_oled_write_data);
+
 	busy_wait();
 
 	 // Set the data bus.
@@ -235,6 +238,8 @@ void oled_write_data(uint8_t data)
 	 // Pulse the enable. (on, off)
 	OLED_PORT_EN |= (1 << OLED_EN);
 	OLED_PORT_EN &= ~(1 << OLED_EN);
+
+	PROFILE_STOP(profile_oled_write_data);
 }
 
 // Set the x and y coordinates for graphics.  Top left is 1,1.
@@ -262,6 +267,8 @@ void oled_write_pixels_at(uint8_t x, uint8_t cy, uint8_t pixels)
 // Reads the busy flag until the display becomes available for another instruction.
 void busy_wait()
 {
+	PROFILE_START(profile_oled_busy_wait);
+
 	// Set data bus bit 7 as input.
 	OLED_DDR_DB7 &= ~(1 << OLED_DB7);
 
@@ -284,6 +291,8 @@ void busy_wait()
 
 	// 0 - write.
 	OLED_PORT_RW &= ~(1 << OLED_RW);
+
+	PROFILE_STOP(profile_oled_busy_wait);
 }
 
 // Sets the data registers to the given data.
@@ -0,0 +1,286 @@
+/*
+ * cgpoll.c
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Star network polling, a coordinator polls each node in turn by weight and the node
+ * answers in the acknowledgment.
+ */
+
+#include "cgpoll.h"
+#include "cgrf.h"
+#include "clock.h"
+#include <string.h>
+
+#define REQUEST_MARKER		0x50
+
+// a silent node costs 4 sends 500 us apart, instead of the profile's 16.
+#define POLL_RETRANSMIT_DELAY	1
+#define POLL_RETRANSMIT_COUNT	3
+
+typedef struct
+{
+	cgpoll_node_stats_t stats;
+	int16_t credit;				// smooth weighted round robin, the node with the most credit goes next.
+	uint16_t last_reply;		// clock_millis() of the last reply, modulo 65536.
+} poll_node_t;
+
+// the nodes share the upper address bytes of the receiver profile's data pipe 1.
+static uint8_t const m_base_address[4] = { 0x02, 0x03, 0x04, 0x01 };
+
+// coordinator.
+static poll_node_t m_nodes[CGPOLL_MAX_NODES];
+static uint8_t m_count = 0;
+static uint8_t m_sequence = 0;
+static poll_node_t * m_in_flight = 0;
+static cgpoll_reply_callback_t m_reply_callback = 0;
+
+// node.
+static uint16_t m_polls = 0;
+
+// function declarations.
+poll_node_t * find_node(uint8_t const address);
+poll_node_t * next_node();
+void pay_credit(poll_node_t * polled);
+void poll_reply(uint8_t const pipe, uint8_t const * const data, uint8_t const size);
+void poll_finished(uint8_t const acknowledged);
+
+// start polling, the coordinator sends to each node in turn and reads its reply from the acknowledgment.
+// turns the radio round to send with auto acknowledgment, clears the node table. requires clock_init().
+void cgpoll_coordinate()
+{
+	m_count = 0;
+	m_in_flight = 0;
+
+	cgrf_turn_round(0);
+	cgrf_set_acknowledgment(auto_acknowledgment);
+	cgrf_set_retransmit(POLL_RETRANSMIT_DELAY, POLL_RETRANSMIT_COUNT);
+	cgrf_set_ack_payload_callback(poll_reply);
+}
+
+// add a node by the least significant byte of its address, polled in proportion to its weight.
+// returns 0 if the table is full or the address is already in it.
+uint8_t cgpoll_add(uint8_t const address, uint8_t const weight)
+{
+	if (m_count == CGPOLL_MAX_NODES || find_node(address) != 0)
+		return 0;
+
+	poll_node_t * node = &m_nodes[m_count];
+	memset(node, 0, sizeof(poll_node_t));
+	node->stats.address = address;
+	node->stats.weight = weight;
+	node->last_reply = clock_millis();
+	m_count++;
+
+	return 1;
+}
+
+// remove a node.
+void cgpoll_remove(uint8_t const address)
+{
+	poll_node_t * node = find_node(address);
+
+	if (node == 0)
+		return;
+
+	// a poll in flight to the node is not counted, cgpoll_update() waits for it to finish before the next.
+	if (m_in_flight == node)
+		m_in_flight = 0;
+
+	// keep the table packed, following the last node if its poll is in flight.
+	m_count--;
+
+	if (m_in_flight == &m_nodes[m_count])
+		m_in_flight = node;
+
+	*node = m_nodes[m_count];
+}
+
+// change a node's weight, 0 stops polling it.
+void cgpoll_set_weight(uint8_t const address, uint8_t const weight)
+{
+	poll_node_t * node = find_node(address);
+
+	if (node != 0)
+	{
+		node->stats.weight = weight;
+		node->credit = 0;
+	}
+}
+
+// set the function called with each reply that carried data, 0 for none.
+void cgpoll_set_reply_callback(cgpoll_reply_callback_t callback)
+{
+	m_reply_callback = callback;
+}
+
+// poll the next node once the previous poll has finished, call from the coordinator's main loop.
+void cgpoll_update()
+{
+	// a reply in the acknowledgment is handled inside cgrf_poll().
+	// a poll orphaned by cgpoll_remove() may still be retrying, the address stays until it finishes.
+	cgrf_send_report_t const * report = cgrf_poll();
+
+	if (report->result == send_in_progress)
+		return;
+
+	if (m_in_flight != 0)
+		poll_finished(report->result == send_success);
+
+	poll_node_t * node = next_node();
+
+	if (node == 0)
+		return;
+
+	uint8_t address[5];
+	address[0] = node->stats.address;
+	memcpy(&address[1], m_base_address, 4);
+
+	// acknowledgments come back on pipe 0, which follows the destination.
+	cgrf_set_tx_address(address);
+
+	uint8_t request[CGPOLL_REQUEST_SIZE];
+	request[0] = REQUEST_MARKER;
+	request[1] = node->stats.address;
+	request[2] = m_sequence;
+
+	// the node keeps its turn and the sequence number if the radio was busy.
+	if (cgrf_send_async(&request[0], CGPOLL_REQUEST_SIZE, delivery_acknowledged) != 0)
+	{
+		m_sequence++;
+		pay_credit(node);
+		node->stats.polls++;
+		m_in_flight = node;
+	}
+}
+
+// get a node's counters, returns 0 if the node is not in the table.
+uint8_t cgpoll_get_stats(uint8_t const address, cgpoll_node_stats_t * stats)
+{
+	poll_node_t * node = find_node(address);
+
+	if (node == 0)
+		return 0;
+
+	*stats = node->stats;
+	return 1;
+}
+
+// listen as a node on CGPOLL_NODE_PIPE, the address byte must not be the one data pipe 1 uses.
+// requires the receiver profile.
+void cgpoll_join(uint8_t const address)
+{
+	m_polls = 0;
+
+	cgrf_set_acknowledgment(auto_acknowledgment);
+	cgrf_set_pipe_address(CGPOLL_NODE_PIPE, address);
+	cgrf_set_pipe_length(CGPOLL_NODE_PIPE, dynamic_length, 0);
+	cgrf_set_pipe_acknowledgment(CGPOLL_NODE_PIPE, auto_acknowledgment);
+	cgrf_enable_pipe(CGPOLL_NODE_PIPE, 1);
+}
+
+// queue the reply for the next poll, returns 0 if the previous reply has not been collected yet.
+uint8_t cgpoll_reply(uint8_t const * const data, uint8_t const size)
+{
+	if (cgrf_ack_queued(CGPOLL_NODE_PIPE) != 0)
+		return 0;
+
+	return cgrf_queue_ack_payload(CGPOLL_NODE_PIPE, data, size);
+}
+
+// pass a received payload to the node, can be given to cgrf_drain_rx() as its callback.
+void cgpoll_receive(uint8_t const pipe, uint8_t const * const data, uint8_t const size)
+{
+	if (pipe == CGPOLL_NODE_PIPE && size == CGPOLL_REQUEST_SIZE && data[0] == REQUEST_MARKER)
+		m_polls++;
+}
+
+// returns the number of polls the node has heard.
+uint16_t cgpoll_polls()
+{
+	return m_polls;
+}
+
+// private functions...
+//
+
+// returns the node with the address, or 0.
+poll_node_t * find_node(uint8_t const address)
+{
+	for (uint8_t i = 0; i < m_count; i++)
+	{
+		if (m_nodes[i].stats.address == address)
+			return &m_nodes[i];
+	}
+
+	return 0;
+}
+
+// every node gains its weight in credit and the node with the most is polled, paying the total.
+// over a round each node is polled in proportion to its weight, spread out rather than in bursts.
+// returns the node to poll, the credit only changes in pay_credit() once the poll has been sent.
+poll_node_t * next_node()
+{
+	poll_node_t * best = 0;
+
+	for (uint8_t i = 0; i < m_count; i++)
+	{
+		poll_node_t * node = &m_nodes[i];
+
+		if (node->stats.weight == 0)
+			continue;
+
+		if (best == 0 || node->credit + node->stats.weight > best->credit + best->stats.weight)
+			best = node;
+	}
+
+	return best;
+}
+
+// add each node's weight to its credit and take the total from the node polled.
+void pay_credit(poll_node_t * polled)
+{
+	int16_t total = 0;
+
+	for (uint8_t i = 0; i < m_count; i++)
+	{
+		poll_node_t * node = &m_nodes[i];
+
+		node->credit += node->stats.weight;
+		total += node->stats.weight;
+	}
+
+	polled->credit -= total;
+}
+
+// a reply came back in the acknowledgment of the poll in flight.
+void poll_reply(uint8_t const pipe, uint8_t const * const data, uint8_t const size)
+{
+	if (m_in_flight != 0 && m_reply_callback != 0)
+		m_reply_callback(m_in_flight->stats.address, data, size);
+}
+
+// count the outcome of the poll in flight.
+void poll_finished(uint8_t const acknowledged)
+{
+	cgpoll_node_stats_t * stats = &m_in_flight->stats;
+
+	if (acknowledged)
+	{
+		uint16_t now = clock_millis();
+
+		stats->replies++;
+		stats->interval_ms = now - m_in_flight->last_reply;
+		m_in_flight->last_reply = now;
+
+		if (stats->interval_ms > stats->worst_interval_ms)
+			stats->worst_interval_ms = stats->interval_ms;
+	}
+	else
+	{
+		stats->lost++;
+	}
+
+	m_in_flight = 0;
+}
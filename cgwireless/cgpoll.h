@@ -0,0 +1,79 @@
+/*
+ * cgpoll.h
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Star network polling, a coordinator polls each node in turn by weight and the node
+ * answers in the acknowledgment.
+ */
+
+#include <stdint.h>
+
+#ifndef CGPOLL_H_
+#define CGPOLL_H_
+
+// largest number of nodes in the coordinator's table.
+#define CGPOLL_MAX_NODES 24
+
+// the poll request, its marker, the node address and a sequence number.
+#define CGPOLL_REQUEST_SIZE 3
+
+// a node's reply is carried in the acknowledgment payload.
+#define CGPOLL_REPLY_SIZE 32
+
+// the data pipe a node listens on.
+#define CGPOLL_NODE_PIPE 2
+
+// counters for one node, kept by the coordinator.
+typedef struct
+{
+	uint8_t address;
+	uint8_t weight;
+	uint16_t polls;
+	uint16_t replies;			// polls acknowledged, with or without data.
+	uint16_t lost;				// polls not acknowledged after the retransmits.
+	uint16_t interval_ms;		// milliseconds between the last two replies.
+	uint16_t worst_interval_ms;
+} cgpoll_node_stats_t;
+
+// called on the coordinator with each reply that carried data.
+typedef void (*cgpoll_reply_callback_t)(uint8_t const address, uint8_t const * const data, uint8_t const size);
+
+// start polling, the coordinator sends to each node in turn and reads its reply from the acknowledgment.
+// turns the radio round to send with auto acknowledgment, clears the node table. requires clock_init().
+void cgpoll_coordinate();
+
+// add a node by the least significant byte of its address, polled in proportion to its weight.
+// returns 0 if the table is full or the address is already in it.
+uint8_t cgpoll_add(uint8_t const address, uint8_t const weight);
+
+// remove a node.
+void cgpoll_remove(uint8_t const address);
+
+// change a node's weight, 0 stops polling it.
+void cgpoll_set_weight(uint8_t const address, uint8_t const weight);
+
+// set the function called with each reply that carried data, 0 for none.
+void cgpoll_set_reply_callback(cgpoll_reply_callback_t callback);
+
+// poll the next node once the previous poll has finished, call from the coordinator's main loop.
+void cgpoll_update();
+
+// get a node's counters, returns 0 if the node is not in the table.
+uint8_t cgpoll_get_stats(uint8_t const address, cgpoll_node_stats_t * stats);
+
+// listen as a node on CGPOLL_NODE_PIPE, the address byte must not be the one data pipe 1 uses.
+// requires the receiver profile.
+void cgpoll_join(uint8_t const address);
+
+// queue the reply for the next poll, returns 0 if the previous reply has not been collected yet.
+uint8_t cgpoll_reply(uint8_t const * const data, uint8_t const size);
+
+// pass a received payload to the node, can be given to cgrf_drain_rx() as its callback.
+void cgpoll_receive(uint8_t const pipe, uint8_t const * const data, uint8_t const size);
+
+// returns the number of polls the node has heard.
+uint16_t cgpoll_polls();
+
+#endif /* CGPOLL_H_ */
@@ -0,0 +1,234 @@
+/*
+ * cgrelay.c
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Store and forward relay, frames carry a routing header and hop toward the sink.
+ */
+
+#include "cgrelay.h"
+#include "cgrf.h"
+#include <string.h>
+
+typedef struct
+{
+	uint8_t size;
+	uint8_t data[32];
+} relay_frame_t;
+
+// the relays share the upper address bytes of the receiver profile's data pipe 1.
+static uint8_t const m_base_address[4] = { 0x02, 0x03, 0x04, 0x01 };
+
+static relay_frame_t m_queue[CGRELAY_QUEUE_SIZE];
+static uint8_t m_head = 0;
+static uint8_t m_queued = 0;
+static uint8_t m_running = 0;
+static uint8_t m_sending = 0;
+static uint8_t m_in_flight = 0;
+static uint8_t m_attempts = 0;
+static uint8_t m_sequence = 0;
+static uint8_t m_next[5];
+static cgrelay_stats_t m_stats;
+
+// the most recent origin and sequence pairs.
+static uint8_t m_seen_origin[CGRELAY_SEEN];
+static uint8_t m_seen_sequence[CGRELAY_SEEN];
+static uint8_t m_seen_next = 0;
+static uint8_t m_seen_count = 0;
+
+// function declarations.
+void relay_receive(uint8_t const pipe, uint8_t const * const data, uint8_t const size);
+void relay_direction(uint8_t const send);
+
+// build a frame from the origin with the routing header, returns its size or 0 if the data is too long.
+// send it acknowledged to the first relay, or to the sink.
+uint8_t cgrelay_pack(uint8_t * frame, uint8_t const origin, uint8_t const * const data, uint8_t const size)
+{
+	if (size > CGRELAY_DATA_SIZE)
+		return 0;
+
+	frame[0] = origin;
+	frame[1] = m_sequence++;
+	frame[2] = CGRELAY_DEFAULT_TTL;
+	frame[3] = 0;
+	memcpy(&frame[CGRELAY_HEADER_SIZE], data, size);
+
+	return CGRELAY_HEADER_SIZE + size;
+}
+
+// start relaying, listen on CGRELAY_PIPE with the address byte and forward to the next address byte.
+// pipe 1, the sink's address, is closed so the relay does not answer for the sink.
+// requires the receiver profile and clock_init().
+void cgrelay_start(uint8_t const listen, uint8_t const next)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+
+	m_head = 0;
+	m_queued = 0;
+	m_in_flight = 0;
+	m_seen_count = 0;
+
+	m_next[0] = next;
+	memcpy(&m_next[1], m_base_address, 4);
+
+	cgrf_set_acknowledgment(auto_acknowledgment);
+	cgrf_enable_pipe(1, 0);
+	cgrf_set_pipe_address(CGRELAY_PIPE, listen);
+	cgrf_set_pipe_length(CGRELAY_PIPE, dynamic_length, 0);
+	cgrf_set_pipe_acknowledgment(CGRELAY_PIPE, auto_acknowledgment);
+	cgrf_enable_pipe(CGRELAY_PIPE, 1);
+
+	m_running = 1;
+	m_sending = 1;
+	relay_direction(0);
+}
+
+// stop relaying, frames still queued are dropped and the radio listens again.
+void cgrelay_stop()
+{
+	if (!m_running)
+		return;
+
+	relay_direction(0);
+	m_queued = 0;
+	m_running = 0;
+}
+
+// receive, forward and turn the radio round, call at least every millisecond.
+void cgrelay_update()
+{
+	if (!m_running)
+		return;
+
+	if (m_in_flight)
+	{
+		cgrf_send_report_t const * report = cgrf_poll();
+
+		if (report->result == send_in_progress)
+			return;
+
+		m_in_flight = 0;
+		m_attempts++;
+
+		if (report->result == send_success || m_attempts >= CGRELAY_ATTEMPTS)
+		{
+			if (report->result == send_success)
+				m_stats.forwarded++;
+			else
+				m_stats.dropped++;
+
+			m_head = (m_head + 1) % CGRELAY_QUEUE_SIZE;
+			m_queued--;
+			m_attempts = 0;
+		}
+
+		// the frames queued go out back to back before listening again.
+		if (m_queued == 0)
+			relay_direction(0);
+	}
+
+	if (!m_sending && cgrf_data_ready())
+		cgrf_drain_rx(relay_receive);
+
+	if (m_queued != 0)
+	{
+		relay_direction(1);
+
+		relay_frame_t const * frame = &m_queue[m_head];
+
+		if (cgrf_send_async(&frame->data[0], frame->size, delivery_acknowledged) != 0)
+			m_in_flight = 1;
+	}
+}
+
+// returns 1 the first time a frame is seen, 0 for a duplicate or a payload without a routing header.
+// for the sink, which takes the data after CGRELAY_HEADER_SIZE.
+uint8_t cgrelay_accept(uint8_t const * const data, uint8_t const size)
+{
+	if (size < CGRELAY_HEADER_SIZE)
+		return 0;
+
+	for (uint8_t i = 0; i < m_seen_count; i++)
+	{
+		if (m_seen_origin[i] == data[0] && m_seen_sequence[i] == data[1])
+		{
+			m_stats.duplicates++;
+			return 0;
+		}
+	}
+
+	// replace the oldest pair.
+	m_seen_origin[m_seen_next] = data[0];
+	m_seen_sequence[m_seen_next] = data[1];
+	m_seen_next = (m_seen_next + 1) % CGRELAY_SEEN;
+
+	if (m_seen_count < CGRELAY_SEEN)
+		m_seen_count++;
+
+	return 1;
+}
+
+// get the relay counters.
+void cgrelay_get_stats(cgrelay_stats_t * stats)
+{
+	*stats = m_stats;
+}
+
+// private functions...
+//
+
+// a frame heard on the relay's address, queued with one hop more and one less to live.
+void relay_receive(uint8_t const pipe, uint8_t const * const data, uint8_t const size)
+{
+	if (pipe != CGRELAY_PIPE)
+		return;
+
+	m_stats.received++;
+
+	// a lost acknowledgment makes the previous hop send the frame again.
+	if (!cgrelay_accept(data, size))
+		return;
+
+	if (data[2] <= 1)
+	{
+		m_stats.expired++;
+		return;
+	}
+
+	if (m_queued == CGRELAY_QUEUE_SIZE)
+	{
+		m_stats.overflows++;
+		return;
+	}
+
+	relay_frame_t * frame = &m_queue[(m_head + m_queued) % CGRELAY_QUEUE_SIZE];
+	memcpy(&frame->data[0], data, size);
+	frame->size = size;
+	frame->data[2]--;
+	frame->data[3]++;
+	m_queued++;
+}
+
+// turn round to send to the next hop, or to listen on the relay's address.
+// pipe 0 receives the next hop's acknowledgments, and is closed while listening
+// so the relay does not answer for the next hop.
+void relay_direction(uint8_t const send)
+{
+	if (m_sending == send)
+		return;
+
+	m_sending = send;
+
+	if (send)
+	{
+		cgrf_turn_round(0);
+		cgrf_set_tx_address(m_next);
+		cgrf_enable_pipe(0, 1);
+	}
+	else
+	{
+		cgrf_enable_pipe(0, 0);
+		cgrf_turn_round(1);
+	}
+}
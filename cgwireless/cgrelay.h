@@ -0,0 +1,77 @@
+/*
+ * cgrelay.h
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Store and forward relay, frames carry a routing header and hop toward the sink.
+ */
+
+#include <stdint.h>
+
+#ifndef CGRELAY_H_
+#define CGRELAY_H_
+
+// each frame starts with its origin, sequence number, time to live and hop count.
+#define CGRELAY_HEADER_SIZE 4
+
+// application bytes carried by a frame.
+#define CGRELAY_DATA_SIZE (32 - CGRELAY_HEADER_SIZE)
+
+// frames a relay holds waiting to be forwarded.
+#define CGRELAY_QUEUE_SIZE 4
+
+// origin and sequence pairs remembered for duplicate suppression.
+#define CGRELAY_SEEN 8
+
+// hops a frame may take before it is dropped.
+#define CGRELAY_DEFAULT_TTL 4
+
+// sends of a frame to the next hop before it is dropped, each with the radio's auto retransmits.
+#define CGRELAY_ATTEMPTS 3
+
+// the data pipe a relay listens on.
+#define CGRELAY_PIPE 2
+
+// the least significant address byte of the sink, the receiver profile's data pipe 1.
+#define CGRELAY_SINK 0x01
+
+#define CGRELAY_ORIGIN(frame) ((frame)[0])
+#define CGRELAY_SEQUENCE(frame) ((frame)[1])
+#define CGRELAY_TTL(frame) ((frame)[2])
+#define CGRELAY_HOPS(frame) ((frame)[3])
+
+// relay counters.
+typedef struct
+{
+	uint16_t received;
+	uint16_t forwarded;
+	uint16_t duplicates;
+	uint16_t expired;		// frames whose time to live ran out.
+	uint16_t overflows;		// frames dropped because the queue was full.
+	uint16_t dropped;		// frames the next hop did not acknowledge.
+} cgrelay_stats_t;
+
+// build a frame from the origin with the routing header, returns its size or 0 if the data is too long.
+// send it acknowledged to the first relay, or to the sink.
+uint8_t cgrelay_pack(uint8_t * frame, uint8_t const origin, uint8_t const * const data, uint8_t const size);
+
+// start relaying, listen on CGRELAY_PIPE with the address byte and forward to the next address byte.
+// pipe 1, the sink's address, is closed so the relay does not answer for the sink.
+// requires the receiver profile and clock_init().
+void cgrelay_start(uint8_t const listen, uint8_t const next);
+
+// stop relaying, frames still queued are dropped and the radio listens again.
+void cgrelay_stop();
+
+// receive, forward and turn the radio round, call at least every millisecond.
+void cgrelay_update();
+
+// returns 1 the first time a frame is seen, 0 for a duplicate or a payload without a routing header.
+// for the sink, which takes the data after CGRELAY_HEADER_SIZE.
+uint8_t cgrelay_accept(uint8_t const * const data, uint8_t const size);
+
+// get the relay counters.
+void cgrelay_get_stats(cgrelay_stats_t * stats);
+
+#endif /* CGRELAY_H_ */
@@ -6,6 +6,8 @@
  */ 
 #include "cgrf.h"
 #include "nrf24l01.h"
+#include "clock.h"
+#include "profile.h"
 #include <string.h>
 
 #ifndef F_CPU				// if F_CPU was not defined in Project -> Properties
@@ -13,6 +15,9 @@
 #endif
 
 #include <util/delay.h>
+#include <avr/pgmspace.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
 
 // Config bits
 #define CONFIG_ENABLE_CRC	0x08
@@ -27,8 +32,26 @@
 #define STATUS_RX_DR		0x40
 #define STATUS_TX_DS		0x20
 #define STATUS_MAX_RT		0x10
+#define STATUS_RX_P_NO		0x0E
 #define STATUS_TX_FIFO_FULL	0x01
 
+// observe transmit bits.
+#define OBSERVE_PLOS_CNT	0xF0
+#define OBSERVE_ARC_CNT		0x0F
+
+// FIFO status bits.
+#define FIFO_TX_REUSE		0x40
+#define FIFO_TX_FULL		0x20
+#define FIFO_TX_EMPTY		0x10
+#define FIFO_RX_FULL		0x02
+#define FIFO_RX_EMPTY		0x01
+
+// microseconds in RX mode before carrier detect (RPD) is valid, Tstby2a + Tdelay_AGC.
+#define RPD_SETTLE_US		170
+
+// largest payload held by a FIFO entry.
+#define MAX_PAYLOAD_SIZE	32
+
 // RF setup bits
 #define RF_DR_1MBPS			0x00
 #define RF_DR_2MBPS			0x08
@@ -95,6 +118,7 @@ typedef enum
 static crc_encoding_t m_crc_encoding = crc_1_byte;
 static power_t m_power = off;
 static mode_t m_mode = transmitter;
+static mode_t m_profile_mode = transmitter;
 static uint8_t m_channel = 100;
 static air_data_rate_t m_data_rate = data_rate_2_mbps;
 static rf_output_power_t m_output_power = power_0dbm;
@@ -106,7 +130,194 @@ static uint8_t m_tx_address[5] = {0x01, 0x02, 0x03, 0x04, 0x01};
 static uint8_t m_pipe0_address[5] = {0x01, 0x02, 0x03, 0x04, 0x01};
 static uint8_t m_pipe1_address[5] = {0x99, 0x98, 0x97, 0x96, 0x01};
 
+// asynchronous send in progress.
+static cgrf_send_report_t m_send = { 0, send_idle, 0 };
+
+// delivery class of the most recent single send, blocking or asynchronous.
+static delivery_t m_send_delivery = delivery_acknowledged;
+static cgrf_send_callback_t m_send_callback = 0;
+static uint32_t m_send_started = 0;
+static uint8_t m_next_ticket = 1;
+
+// acknowledgment payload waiting in the pool.
+typedef struct
+{
+	uint8_t next;		// pool index + 1 of the next payload for the pipe, 0 for none.
+	uint8_t size;
+	uint8_t data[MAX_PAYLOAD_SIZE];
+} ack_slot_t;
+
+// acknowledgment payloads, queued per data pipe from a shared pool.
+// the queue heads and tails hold pool index + 1, 0 for an empty queue.
+static ack_slot_t m_ack_pool[CGRF_ACK_POOL_SIZE];
+static uint8_t m_ack_used = 0;
+static uint8_t m_ack_head[CGRF_PIPES];
+static uint8_t m_ack_tail[CGRF_PIPES];
+
+// pipes with a payload in the TX FIFO, and pipes whose payload has gone out with an acknowledgment.
+static volatile uint8_t m_ack_loaded = 0;
+static volatile uint8_t m_ack_sent = 0;
+static cgrf_rx_callback_t m_ack_callback = 0;
+
+// frequency hopping, the sequence holds the channels in their seeded order.
+// m_hop_count is 0 when not hopping.
+static uint8_t m_hop_sequence[CGRF_HOP_MAX_CHANNELS];
+static uint8_t m_hop_strikes[CGRF_HOP_MAX_CHANNELS];
+static uint8_t m_hop_penalty[CGRF_HOP_MAX_CHANNELS];
+static uint8_t m_hop_count = 0;
+static uint8_t m_hop_index = 0;
+static uint16_t m_hop_interval = 0;
+static uint32_t m_hop_slot_start = 0;
+static uint8_t m_hop_synchronised = 0;
+static uint8_t m_hop_silent = 0;
+static uint8_t m_hop_heard_in_slot = 0;
+static uint16_t m_hop_hops = 0;
+static uint16_t m_hop_resyncs = 0;
+
+// set when a frame is received, with the time of the first frame since the last update.
+static volatile uint8_t m_hop_heard = 0;
+static volatile uint32_t m_hop_heard_at = 0;
+
+// receive counters per data pipe.
+static cgrf_pipe_stats_t m_pipe_stats[CGRF_PIPES];
+
+// link counters, and the payloads received in the second starting at m_rate_start.
+static cgrf_stats_t m_stats;
+static uint32_t m_rate_start = 0;
+static uint16_t m_rate_count = 0;
+
+// a blocking send whose outcome has not been counted yet.
+static uint8_t m_ack_pending = 0;
+
+// receive ring, filled at the tail and consumed from the head.
+static cgrf_frame_t m_ring[CGRF_RX_RING_SIZE];
+static volatile uint8_t m_ring_head = 0;
+static volatile uint8_t m_ring_tail = 0;
+static cgrf_ring_stats_t m_ring_stats;
+
+// transmit stream counts, and payloads written to the FIFO but not yet accounted for.
+static cgrf_stream_t m_stream;
+static uint8_t m_stream_in_flight = 0;
+static delivery_t m_stream_delivery = delivery_acknowledged;
+
+// clock_millis() when the stream last made progress, the payloads in flight are dropped
+// once it has made none for CGRF_SEND_TIMEOUT_MS.
+static uint32_t m_stream_progress = 0;
+
+// Radio profiles
+// --------------
+// complete register settings for each mode, streamed to the chip by cgrf_apply_profile().
+// the channel and addresses are not part of a profile, they are set after the table.
+// CONFIG is last in each table, CE stays low until the channel and addresses are set,
+// so the chip only powers up into standby while they change.
+
+#define PROFILE_END			0xFF
+
+typedef struct
+{
+	uint8_t reg;
+	uint8_t value;
+} register_value_t;
+
+// transmitter, auto retransmit up to 15 times every 500 us, dynamic payload length.
+static register_value_t const m_transmitter_profile[] PROGMEM =
+{
+	{ RMAP_EN_AA,		0x00 },
+	{ RMAP_EN_RXADDR,	ERX_P0 | ERX_P1 },
+	{ RMAP_SETUP_AW,	AW_5BYTES },
+	{ RMAP_SETUP_RETR,	ARD_WAIT_500US | 0x0F },
+	{ RMAP_RF_SETUP,	RF_DR_2MBPS | RF_PWR_0DBM },
+	{ RMAP_RX_PW_P0,	0x00 },
+	{ RMAP_RX_PW_P1,	0x00 },
+	{ RMAP_RX_PW_P2,	0x00 },
+	{ RMAP_RX_PW_P3,	0x00 },
+	{ RMAP_RX_PW_P4,	0x00 },
+	{ RMAP_RX_PW_P5,	0x00 },
+	{ RMAP_DYNPD,		DPL_P0 | DPL_P1 },
+	{ RMAP_FEATURE,		FEATURE_EN_DPL },
+	{ RMAP_CONFIG,		CONFIG_ENABLE_CRC | CONFIG_CRC_1BYTE | CONFIG_PWR_UP | CONFIG_PRIM_PTX },
+	{ PROFILE_END,		0x00 },
+};
+
+// receiver on data pipe 1, dynamic payload length.
+static register_value_t const m_receiver_profile[] PROGMEM =
+{
+	{ RMAP_EN_AA,		0x00 },
+	{ RMAP_EN_RXADDR,	ERX_P0 | ERX_P1 },
+	{ RMAP_SETUP_AW,	AW_5BYTES },
+	{ RMAP_SETUP_RETR,	ARD_WAIT_500US | 0x0F },
+	{ RMAP_RF_SETUP,	RF_DR_2MBPS | RF_PWR_0DBM },
+	{ RMAP_RX_PW_P0,	0x00 },
+	{ RMAP_RX_PW_P1,	0x00 },
+	{ RMAP_RX_PW_P2,	0x00 },
+	{ RMAP_RX_PW_P3,	0x00 },
+	{ RMAP_RX_PW_P4,	0x00 },
+	{ RMAP_RX_PW_P5,	0x00 },
+	{ RMAP_DYNPD,		DPL_P0 | DPL_P1 },
+	{ RMAP_FEATURE,		FEATURE_EN_DPL },
+	{ RMAP_CONFIG,		CONFIG_ENABLE_CRC | CONFIG_CRC_1BYTE | CONFIG_PWR_UP | CONFIG_PRIM_PRX },
+	{ PROFILE_END,		0x00 },
+};
+
+// receiver with CRC and auto acknowledgment off, for carrier detection.
+static register_value_t const m_channel_scan_profile[] PROGMEM =
+{
+	{ RMAP_EN_AA,		0x00 },
+	{ RMAP_EN_RXADDR,	ERX_P0 | ERX_P1 },
+	{ RMAP_SETUP_AW,	AW_5BYTES },
+	{ RMAP_RF_SETUP,	RF_DR_2MBPS | RF_PWR_0DBM },
+	{ RMAP_DYNPD,		0x00 },
+	{ RMAP_FEATURE,		0x00 },
+	{ RMAP_CONFIG,		CONFIG_PWR_UP | CONFIG_PRIM_PRX },
+	{ PROFILE_END,		0x00 },
+};
+
+// transmitter with no acknowledgment or retransmits at the lowest output power.
+static register_value_t const m_low_power_beacon_profile[] PROGMEM =
+{
+	{ RMAP_EN_AA,		0x00 },
+	{ RMAP_EN_RXADDR,	0x00 },
+	{ RMAP_SETUP_AW,	AW_5BYTES },
+	{ RMAP_SETUP_RETR,	0x00 },
+	{ RMAP_RF_SETUP,	RF_DR_2MBPS | RF_PWR_MINUS_18DBM },
+	{ RMAP_RX_PW_P0,	0x00 },
+	{ RMAP_RX_PW_P1,	0x00 },
+	{ RMAP_RX_PW_P2,	0x00 },
+	{ RMAP_RX_PW_P3,	0x00 },
+	{ RMAP_RX_PW_P4,	0x00 },
+	{ RMAP_RX_PW_P5,	0x00 },
+	{ RMAP_DYNPD,		DPL_P0 | DPL_P1 },
+	{ RMAP_FEATURE,		FEATURE_EN_DPL },
+	{ RMAP_CONFIG,		CONFIG_ENABLE_CRC | CONFIG_CRC_1BYTE | CONFIG_PWR_UP | CONFIG_PRIM_PTX },
+	{ PROFILE_END,		0x00 },
+};
+
 // function declarations.
+void read_settings();
+uint8_t payload_width(uint8_t const pipe, uint8_t const dynamic_width);
+void count_frame(uint8_t const pipe, uint8_t const size);
+void count_send(send_result_t const result, uint8_t const retransmits);
+void count_outcome(send_result_t const result, uint8_t const retransmits);
+void count_delivered(delivery_t const delivery, uint8_t const count);
+void count_acknowledgment(acknowledgment_t const ack);
+void settle_acknowledgment();
+void update_pipe_bit(uint8_t const reg_map_addr, uint8_t const pipe, uint8_t const set);
+void ack_service();
+void send_payload(uint8_t const * const data, uint8_t const size, delivery_t const delivery);
+void enable_dynamic_ack();
+void survey_add(cgrf_survey_t * survey, uint8_t const channel, uint8_t const hits);
+uint8_t survey_score(cgrf_survey_t const * const survey, uint8_t const channel);
+void hop_tune();
+void hop_resync(uint32_t const heard_at);
+void hop_strike(uint8_t const failed);
+uint8_t hop_blacklisted();
+void ack_deliver();
+cgrf_frame_t * ring_reserve();
+void ring_start();
+void ring_irq(uint8_t const flags);
+void ring_commit(uint8_t const pipe, uint8_t const size);
+uint8_t stream_update();
+void start_profile(cgrf_profile_t const profile);
 uint8_t set_auto_ack();
 uint8_t set_dynamic_payload();
 uint8_t set_features();
@@ -122,6 +333,12 @@ uint8_t set_pipe1_address();
 void cgrf_init()
 {
 	nrf24_configure_ports();
+
+	// the chip takes up to 100 ms to come out of its power on reset, the shadow
+	// must not be loaded from whatever MISO reads before then.
+	_delay_ms(100);
+
+	nrf24_resync_registers();
 }
 
 // set the channel.
@@ -157,6 +374,20 @@ void cgrf_set_output_power(rf_output_power_t const output_power)
 	}
 }
 
+// set the auto retransmit delay in 250 us steps (0 = 250 us to 15 = 4000 us) and count (0 to 15).
+void cgrf_set_retransmit(uint8_t const delay, uint8_t const count)
+{
+	if (delay <= 15 && count <= 15)
+		nrf24_update_register(RMAP_SETUP_RETR, (delay << 4) | count);
+}
+
+// set CE high again after settings were changed in standby, if the radio is a powered up receiver.
+void cgrf_restore_ce()
+{
+	if (m_mode == reciever && m_power == on)
+		nrf24_set_ce_high();
+}
+
 // set the cyclic encoding scheme.
 void cgrf_set_crc_encoding(crc_encoding_t const crc)
 {
@@ -169,7 +400,7 @@ void cgrf_set_crc_encoding(crc_encoding_t const crc)
 	}
 }
 
-// set the auto acknowledgment.
+// set the auto acknowledgment of data pipes 0 and 1, pipes 2 to 5 keep their own.
 void cgrf_set_acknowledgment(auto_ack_t const ack)
 {
 	if (m_auto_ack != ack)
@@ -180,7 +411,7 @@ void cgrf_set_acknowledgment(auto_ack_t const ack)
 	}	
 }
 
-// set the payload length.
+// set the payload length of data pipes 0 and 1, pipes 2 to 5 keep their own.
 void cgrf_set_length(payload_length_t const length, uint8_t const size)
 {
 	if (m_payload_length == dynamic_length)
@@ -212,119 +443,291 @@ void cgrf_set_length(payload_length_t const length, uint8_t const size)
 	}
 }
 
-// set the transmit destination address.
-void cgrf_set_tx_address(uint8_t address[5])
+// enable or disable receive data pipe 0 to 5.
+void cgrf_enable_pipe(uint8_t const pipe, uint8_t const enable)
 {
-	if (memcmp(address, m_tx_address, 5) != 0)
+	if (pipe < CGRF_PIPES)
+		update_pipe_bit(RMAP_EN_RXADDR, pipe, enable);
+}
+
+// set the least significant address byte of data pipe 2 to 5.
+// the other address bytes are shared with data pipe 1.
+void cgrf_set_pipe_address(uint8_t const pipe, uint8_t const lsb)
+{
+	if (pipe >= 2 && pipe < CGRF_PIPES)
+		nrf24_update_register(RMAP_RX_ADDR_P0 + pipe, lsb);
+}
+
+// set the payload length of data pipe 0 to 5, size is used for static length.
+void cgrf_set_pipe_length(uint8_t const pipe, payload_length_t const length, uint8_t const size)
+{
+	if (pipe >= CGRF_PIPES || size > MAX_PAYLOAD_SIZE)
+		return;
+
+	if (length == dynamic_length)
+	{
+		// dynamic payload length must also be enabled in the feature register.
+		uint8_t feature = 0;
+		nrf24_get_feature(&feature);
+		nrf24_update_register(RMAP_FEATURE, feature | FEATURE_EN_DPL);
+
+		// the chip requires auto acknowledgment on a pipe with dynamic payload length.
+		update_pipe_bit(RMAP_EN_AA, pipe, 1);
+		update_pipe_bit(RMAP_DYNPD, pipe, 1);
+	}
+	else
 	{
-		memcpy(address, m_tx_address, 5);
-		set_tx_address();
-		set_pipe0_address();
+		update_pipe_bit(RMAP_DYNPD, pipe, 0);
+		nrf24_update_register(RMAP_RX_PW_P0 + pipe, size);
 	}
 }
 
-// setup as a transmitter and power up.
-void cgrf_start_as_transmitter()
+// set the auto acknowledgment of data pipe 0 to 5.
+void cgrf_set_pipe_acknowledgment(uint8_t const pipe, auto_ack_t const ack)
 {
-	// reserved automatic acknowledgment pipe only allows 0x00.
-	nrf24_set_rx_pw_p0(0x00);
+	if (pipe < CGRF_PIPES)
+		update_pipe_bit(RMAP_EN_AA, pipe, ack == auto_acknowledgment);
+}
 
-	// set number of bytes to zero for unused data pipes.
-	nrf24_set_rx_pw_p2(0x00);
-	nrf24_set_rx_pw_p3(0x00);
-	nrf24_set_rx_pw_p4(0x00);
-	nrf24_set_rx_pw_p5(0x00);
-	
-	// enable auto acknowledgment (enhanced ShockBurst).
-	set_auto_ack();
+// get a snapshot of the link counters.
+void cgrf_get_stats(cgrf_stats_t * stats)
+{
+	uint8_t sreg = SREG;
+	cli();
 
-	// enable RX addresses for data pipes 0 and 1
-	nrf24_set_en_rxaddr(ERX_P0 | ERX_P1);
+	*stats = m_stats;
 
-	// auto retransmit delay wait 1000 us
-	// auto retransmit count, up to 15 (0x0F) retransmits on fail.
-	nrf24_set_setup_retr(ARD_WAIT_500US | 0x0F);
-	
-	// set address width to 5 bytes.
-	nrf24_set_setup_aw(AW_5BYTES);
+	// the count for the second in progress is not complete, and no frame has closed it.
+	uint32_t elapsed = clock_millis() - m_rate_start;
 
-	set_dynamic_payload();
-	set_features();
+	if (elapsed >= 2000)
+		stats->rx_per_second = 0;
+	else if (elapsed >= 1000)
+		stats->rx_per_second = m_rate_count;
 
-	// number of bytes in RX payload for data pipe.
-	set_payload1_size();
-	
-	set_channel();
-	set_rf_setup();
+	SREG = sreg;
+}
 
-	// set the addresses.
-	set_tx_address();
-	set_pipe0_address();
-	set_pipe1_address();
-	
-	// flush the buffers.
-	nrf24_flush_rx();
-	nrf24_flush_tx();
+// reset the link counters.
+void cgrf_reset_stats()
+{
+	uint8_t sreg = SREG;
+	cli();
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_rate_start = clock_millis();
+	m_rate_count = 0;
+	SREG = sreg;
+}
 
-	// clear the status bits by setting them to 1.
-	nrf24_set_status(STATUS_RX_DR | STATUS_TX_DS | STATUS_MAX_RT);
+// get the receive counters of data pipe 0 to 5.
+void cgrf_get_pipe_stats(uint8_t const pipe, cgrf_pipe_stats_t * stats)
+{
+	if (pipe >= CGRF_PIPES)
+		return;
+
+	uint8_t sreg = SREG;
+	cli();
+	*stats = m_pipe_stats[pipe];
+	SREG = sreg;
+}
+
+// reset the receive counters of every data pipe.
+void cgrf_reset_pipe_stats()
+{
+	uint8_t sreg = SREG;
+	cli();
+	memset(m_pipe_stats, 0, sizeof(m_pipe_stats));
+	SREG = sreg;
+}
+
+// queue a payload to be sent back to the node on a data pipe with the next acknowledgment.
+// needs auto acknowledgment and dynamic payload length, returns 0 if every pool slot is in use.
+uint8_t cgrf_queue_ack_payload(uint8_t const pipe, uint8_t const * const data, uint8_t const size)
+{
+	if (pipe >= CGRF_PIPES || size == 0 || size > MAX_PAYLOAD_SIZE)
+		return 0;
+
+	uint8_t index = 0;
+
+	while (index < CGRF_ACK_POOL_SIZE && (m_ack_used & (1 << index)))
+		index++;
+
+	if (index == CGRF_ACK_POOL_SIZE)
+		return 0;
+
+	ack_slot_t * slot = &m_ack_pool[index];
+	slot->next = 0;
+	slot->size = size;
+	memcpy(slot->data, data, size);
+	m_ack_used |= (1 << index);
 
-	m_mode = transmitter;
-	cgrf_power_up();
+	// append to the queue for the pipe.
+	if (m_ack_tail[pipe] != 0)
+		m_ack_pool[m_ack_tail[pipe] - 1].next = index + 1;
+	else
+		m_ack_head[pipe] = index + 1;
+
+	m_ack_tail[pipe] = index + 1;
+
+	ack_service();
+	return 1;
+}
+
+// returns the number of payloads waiting to go back on a data pipe.
+uint8_t cgrf_ack_queued(uint8_t const pipe)
+{
+	if (pipe >= CGRF_PIPES)
+		return 0;
+
+	ack_service();
+
+	uint8_t count = 0;
+
+	for (uint8_t next = m_ack_head[pipe]; next != 0; next = m_ack_pool[next - 1].next)
+		count++;
+
+	return count;
+}
+
+// drop every queued acknowledgment payload.
+void cgrf_clear_ack_payloads()
+{
+	if (m_ack_loaded != 0)
+		nrf24_flush_tx();
+
+	m_ack_used = 0;
+	m_ack_loaded = 0;
+	m_ack_sent = 0;
+	memset(m_ack_head, 0, sizeof(m_ack_head));
+	memset(m_ack_tail, 0, sizeof(m_ack_tail));
+}
+
+// set the function called on the transmitter for each payload that came back with an acknowledgment, 0 for none.
+void cgrf_set_ack_payload_callback(cgrf_rx_callback_t callback)
+{
+	m_ack_callback = callback;
+}
+
+// set the transmit destination address.
+void cgrf_set_tx_address(uint8_t address[5])
+{
+	// acknowledgments come back on data pipe 0, so it follows the destination.
+	memcpy(m_tx_address, address, 5);
+	memcpy(m_pipe0_address, address, 5);
+
+	// the shadow skips the writes when the registers already hold the address,
+	// cgrf_turn_round() can have changed TX_ADDR since the last call.
+	nrf24_update_register_bytes(RMAP_TX_ADDR, m_tx_address, 5);
+	nrf24_update_register_bytes(RMAP_RX_ADDR_P0, m_pipe0_address, 5);
+}
+
+// setup as a transmitter and power up.
+// settings made with the cgrf_set_* functions are kept.
+void cgrf_start_as_transmitter()
+{
+	start_profile(profile_transmitter);
 }
 
 // setup as a receiver and power up.
+// settings made with the cgrf_set_* functions are kept.
 void cgrf_start_as_reciever()
 {
-	// reserved automatic acknowledgment pipe only allows 0x00.
-	nrf24_set_rx_pw_p0(0x00);
+	start_profile(profile_receiver);
+}
 
-	// set number of bytes to zero for unused data pipes.
-	nrf24_set_rx_pw_p2(0x00);
-	nrf24_set_rx_pw_p3(0x00);
-	nrf24_set_rx_pw_p4(0x00);
-	nrf24_set_rx_pw_p5(0x00);
-	
-	// enable auto acknowledgment (enhanced ShockBurst).
-	set_auto_ack();
+// apply a complete radio profile, switch mode and power up.
+// registers already holding the profile value are not written.
+void cgrf_apply_profile(cgrf_profile_t const profile)
+{
+	register_value_t const * entry = m_transmitter_profile;
 
-	// enable RX addresses for data pipes 0 and 1
-	nrf24_set_en_rxaddr(ERX_P0 | ERX_P1);
+	if (profile == profile_receiver)
+		entry = m_receiver_profile;
 
-	// auto retransmit delay wait 1000 us
-	// auto retransmit count, up to 15 (0x0F) retransmits on fail.
-	nrf24_set_setup_retr(ARD_WAIT_500US | 0x0F);
-	
-	// set address width to 5 bytes.
-	nrf24_set_setup_aw(AW_5BYTES);
+	else if (profile == profile_channel_scan)
+		entry = m_channel_scan_profile;
 
-	set_dynamic_payload();
-	set_features();
+	else if (profile == profile_low_power_beacon)
+		entry = m_low_power_beacon_profile;
 
-	// number of bytes in RX payload for data pipe.
-	set_payload1_size();
-	
-	set_channel();
-	set_rf_setup();
+	// registers must only be changed in power down or standby.
+	nrf24_set_ce_low();
+
+	// stream the table from flash.
+	uint8_t reg = pgm_read_byte(&entry->reg);
+
+	while (reg != PROFILE_END)
+	{
+		nrf24_update_register(reg, pgm_read_byte(&entry->value));
+		entry++;
+		reg = pgm_read_byte(&entry->reg);
+	}
+
+	// follow the settings held in the registers.
+	read_settings();
+	m_profile_mode = m_mode;
+
+	nrf24_update_register(RMAP_RF_CH, m_channel);
 
 	// set the addresses.
-	m_pipe1_address[0] = 0x01;
-	m_pipe1_address[1] = 0x02;
-	m_pipe1_address[2] = 0x03;
-	m_pipe1_address[3] = 0x04;
-	m_pipe1_address[4] = 0x01;
+	if (m_mode == transmitter)
+	{
+		nrf24_update_register_bytes(RMAP_TX_ADDR, m_tx_address, 5);
+		nrf24_update_register_bytes(RMAP_RX_ADDR_P0, m_pipe0_address, 5);
+	}
+	else
+	{
+		m_pipe1_address[0] = 0x01;
+		m_pipe1_address[1] = 0x02;
+		m_pipe1_address[2] = 0x03;
+		m_pipe1_address[3] = 0x04;
+		m_pipe1_address[4] = 0x01;
+	}
 
-	set_pipe1_address();
+	nrf24_update_register_bytes(RMAP_RX_ADDR_P1, m_pipe1_address, 5);
 
 	// flush the buffers.
 	nrf24_flush_rx();
 	nrf24_flush_tx();
 
+	// queued acknowledgment payloads are loaded again.
+	m_ack_loaded = 0;
+	m_ack_sent = 0;
+
 	// clear the status bits by setting them to 1.
 	nrf24_set_status(STATUS_RX_DR | STATUS_TX_DS | STATUS_MAX_RT);
 
-	m_mode = reciever;
-	cgrf_power_up();
+	// every profile ends powered up, a receiver listens with CE high.
+	cgrf_restore_ce();
+}
+
+// turn the radio round to listen or to send, without applying a profile.
+// a receiver sends to the address it listens on, and a transmitter listens on pipe 0, its own
+// address, so a payload sent by the receiver reaches every transmitter that is listening.
+void cgrf_turn_round(uint8_t const listen)
+{
+	mode_t mode = listen ? reciever : transmitter;
+
+	if (m_mode == mode)
+		return;
+
+	nrf24_set_ce_low();
+	m_mode = mode;
+
+	if (m_profile_mode == reciever && mode == transmitter)
+	{
+		nrf24_update_register_bytes(RMAP_TX_ADDR, m_pipe1_address, 5);
+
+		// loaded acknowledgment payloads would be sent first, they are loaded again once listening.
+		if (m_ack_loaded != 0)
+			nrf24_flush_tx();
+
+		m_ack_loaded = 0;
+		m_ack_sent = 0;
+	}
+
+	// CE goes high again when listening.
+	set_config();
 }
 
 // power up the transmitter/receiver.
@@ -353,35 +756,197 @@ uint8_t cgrf_power_down()
 	return 0;
 }
 
-// send data.
-acknowledgment_t cgrf_transmit_data(uint8_t const * const data, uint8_t const size)
+// send data, an unacknowledged payload is sent once without waiting for an acknowledgment.
+acknowledgment_t cgrf_transmit_data(uint8_t const * const data, uint8_t const size, delivery_t const delivery)
 {
-	nrf24_transmit_data(standby_II_fast_start, data, size);
+	settle_acknowledgment();
+
+	m_stats.sent++;
+	m_ack_pending = 1;
+
+	send_payload(data, size, delivery);
 	
 	acknowledgment_t ack = cgrf_check_acknowledgment();
-	
+
+	// a send still retrying keeps its flags, its outcome is counted when it is seen.
 	// Note: write one to clear the bit.
 	// clear transmitted and clear number of retries bits.
-	nrf24_set_status(STATUS_TX_DS | STATUS_MAX_RT);
+	if (ack != failed_retry_in_progress)
+		nrf24_set_status(STATUS_TX_DS | STATUS_MAX_RT);
+
+	if (ack == success)
+		ack_deliver();
 	
 	return ack;
 }
 
 acknowledgment_t cgrf_retransmit()
 {
+	settle_acknowledgment();
+
+	m_stats.sent++;
+	m_ack_pending = 1;
+
 	nrf24_retransmit(standby_II_fast_start);
 
 	acknowledgment_t ack = cgrf_check_acknowledgment();
 	
 	// Note: write one to clear the bit.
 	// clear transmitted and clear number of retries bits.
-	nrf24_set_status(STATUS_TX_DS | STATUS_MAX_RT);
+	if (ack != failed_retry_in_progress)
+		nrf24_set_status(STATUS_TX_DS | STATUS_MAX_RT);
 	
 	return ack;
 }
 
+// start a transmit stream, CE is held high (Standby-II) until cgrf_stream_end().
+// every payload on the stream is sent with the given delivery class.
+// returns 0 unless the radio is a powered up transmitter.
+uint8_t cgrf_stream_begin(delivery_t const delivery)
+{
+	// CE high would only listen on a receiver, and nothing is sent while powered down.
+	if (m_mode != transmitter || m_power != on)
+		return 0;
+
+	m_stream.queued = 0;
+	m_stream.delivered = 0;
+	m_stream.failed = 0;
+	m_stream_in_flight = 0;
+	m_stream_delivery = delivery;
+	m_stream_progress = clock_millis();
+
+	if (delivery == delivery_unacknowledged)
+		enable_dynamic_ack();
+
+	// each payload is sent as soon as it reaches the TX FIFO.
+	nrf24_set_ce_high();
+
+	return 1;
+}
+
+// queue a payload on the stream, returns 0 if the TX FIFO is full.
+uint8_t cgrf_stream_push(uint8_t const * const data, uint8_t const size)
+{
+	uint8_t status = stream_update();
+
+	if (status & STATUS_TX_FIFO_FULL)
+		return 0;
+
+	if (m_stream_delivery == delivery_unacknowledged)
+		nrf24_load_payload_no_ack(data, size);
+	else
+		nrf24_load_payload(data, size);
+
+	m_stream.queued++;
+	m_stream_in_flight++;
+
+	return 1;
+}
+
+// wait for the TX FIFO to empty, end the stream and return the payload counts.
+void cgrf_stream_end(cgrf_stream_t * result)
+{
+	while (m_stream_in_flight != 0)
+		stream_update();
+
+	nrf24_set_ce_low();
+	*result = m_stream;
+}
+
+// start sending a payload without waiting for the outcome.
+// returns a ticket, or 0 if the previous send is still in progress.
+uint8_t cgrf_send_async(uint8_t const * const data, uint8_t const size, delivery_t const delivery)
+{
+	if (cgrf_poll()->result == send_in_progress)
+		return 0;
+
+	// count and clear the outcome of the previous send.
+	settle_acknowledgment();
+
+	m_send.ticket = m_next_ticket;
+	m_send.result = send_in_progress;
+	m_send.retransmits = 0;
+	m_send_started = clock_millis();
+
+	// tickets run 1 to 255, 0 means no ticket.
+	m_next_ticket++;
+
+	if (m_next_ticket == 0)
+		m_next_ticket = 1;
+
+	send_payload(data, size, delivery);
+
+	return m_send.ticket;
+}
+
+// set the function called when a send completes, 0 for none.
+void cgrf_set_send_callback(cgrf_send_callback_t callback)
+{
+	m_send_callback = callback;
+}
+
+// advance the send in progress and return the report for the most recent ticket.
+cgrf_send_report_t const * cgrf_poll()
+{
+	if (m_send.result != send_in_progress)
+		return &m_send;
+
+	uint8_t status = 0;
+
+#ifdef NRF24_IRQ_ENABLED
+	// STATUS only needs reading once the IRQ line has signalled.
+	if (nrf24_irq_pending())
+#endif
+		nrf24_get_status(&status);
+
+	if (status & STATUS_TX_DS)
+	{
+		m_send.result = send_success;
+		ack_deliver();
+	}
+	else if (status & STATUS_MAX_RT)
+	{
+		// the payload stays in the FIFO after the last retransmit.
+		nrf24_flush_tx();
+		m_send.result = send_max_retries;
+	}
+	else if (clock_elapsed(m_send_started) >= CGRF_SEND_TIMEOUT_MS)
+	{
+		nrf24_flush_tx();
+		m_send.result = send_timeout;
+	}
+	else
+	{
+		return &m_send;
+	}
+
+	// auto retransmit count (ARC_CNT) for the payload.
+	uint8_t observe = 0;
+	nrf24_get_observe_tx(&observe);
+	m_send.retransmits = observe & OBSERVE_ARC_CNT;
+	count_send(m_send.result, m_send.retransmits);
+
+	// the channel has not changed while the send was in progress.
+	if (m_hop_count != 0)
+		hop_strike(m_send.result != send_success);
+
+	// Note: write one to clear the bit.
+	nrf24_set_status(STATUS_TX_DS | STATUS_MAX_RT);
+
+	if (m_send_callback != 0)
+		m_send_callback(&m_send);
+
+	return &m_send;
+}
+
 uint8_t cgrf_data_ready()
 {
+#ifdef NRF24_IRQ_ENABLED
+	// nothing has been signalled on the IRQ line, no need to read STATUS.
+	if (!nrf24_irq_pending())
+		return 0;
+#endif
+
 	uint8_t status = 0;
 	nrf24_get_status(&status);
 
@@ -395,8 +960,17 @@ uint8_t cgrf_data_ready()
 
 uint8_t cgrf_get_payload(uint8_t * data, uint8_t const size)
 {
+	PROFILE_START(profile_rf_receive);
+
 	uint8_t plsize = 0;
-	nrf24_get_payload_size(&plsize);
+	uint8_t status = nrf24_get_payload_size(&plsize);
+	uint8_t pipe = (status & STATUS_RX_P_NO) >> 1;
+
+	if (pipe < CGRF_PIPES)
+	{
+		plsize = payload_width(pipe, plsize);
+		count_frame(pipe, plsize);
+	}
 
 	if (plsize != 0)
 	{
@@ -406,7 +980,6 @@ uint8_t cgrf_get_payload(uint8_t * data, uint8_t const size)
 			nrf24_get_payload(data, size);
 	}
 
-	uint8_t status = 0;
 	nrf24_get_status(&status);
 
 	if (status & STATUS_RX_DR)
@@ -414,79 +987,1204 @@ uint8_t cgrf_get_payload(uint8_t * data, uint8_t const size)
 		// Note: write one to clear the bit.
 		nrf24_set_status(STATUS_RX_DR);
 	}
-	
+
+	ack_service();
+
+	PROFILE_STOP(profile_rf_receive);
 	return status;
 }
 
-
-acknowledgment_t cgrf_check_acknowledgment()
+// read every payload waiting in the receive FIFO, passing each to the callback.
+// returns the number of payloads read.
+uint8_t cgrf_drain_rx(cgrf_rx_callback_t callback)
 {
-	uint8_t status = 0;
-	nrf24_get_status(&status);
+	uint8_t buffer[MAX_PAYLOAD_SIZE];
+	uint8_t count = 0;
+	uint8_t fifo = 0;
+	
+	nrf24_get_fifo_status(&fifo);
 
-	// auto acknowledgment received.
-	if (status & STATUS_TX_DS)
-		return success;
+	if (fifo & FIFO_RX_FULL)
+		m_stats.rx_fifo_full++;
 
-	if (status & STATUS_MAX_RT)
-		return failed;
+	while (1)
+	{
+		if (fifo & FIFO_RX_EMPTY)
+		{
+			// FIFO is empty, clear the data ready flag.
+			// Note: write one to clear the bit.
+			nrf24_set_status(STATUS_RX_DR);
 
-	return failed_retry_in_progress;
-}
+			// a payload arriving before the flag was cleared would not raise it again.
+			nrf24_get_fifo_status(&fifo);
 
-// private functions...
-//
-uint8_t set_auto_ack()
-{
-	uint8_t cmd = 0x00;
-	
-	if (m_auto_ack == auto_acknowledgment)
-		cmd |= ENAA_P0 | ENAA_P1 | ENAA_P2 | ENAA_P3 | ENAA_P4 | ENAA_P5;
+			if (fifo & FIFO_RX_EMPTY)
+				break;
+		}
 
-	// enable auto acknowledgment (enhanced ShockBurst) for all data pipes.
-	return nrf24_set_en_aa(cmd);
-}
+		uint8_t plsize = 0;
 
+		// the status shifted out with the width command holds the pipe of the payload at the top of the FIFO.
+		uint8_t status = nrf24_get_payload_size(&plsize);
+		uint8_t pipe = (status & STATUS_RX_P_NO) >> 1;
 
-uint8_t set_dynamic_payload()
-{
-	uint8_t cmd = 0x00;
+		plsize = payload_width(pipe, plsize);
 
-	if (m_payload_length == dynamic_length)
-	{
-		// Enable dynamically sized packets on the 2 RX pipes we use, 0 and 1.
-		// RX pipe address 1 is used to for normal packets from radios that send us data.
-		// RX pipe address 0 is used to for auto-acknowledgment packets from radios we transmit to.
-		cmd |= DPL_P0 | DPL_P1;
+		// a width greater than 32 is corrupt and the FIFO must be flushed.
+		if (plsize > MAX_PAYLOAD_SIZE)
+		{
+			m_stats.corrupt++;
+			nrf24_flush_rx();
+			fifo = FIFO_RX_EMPTY;
+			continue;
+		}
+
+		nrf24_get_payload(&buffer[0], plsize);
+		count_frame(pipe, plsize);
+		count++;
+
+		if (callback != 0)
+			callback(pipe, &buffer[0], plsize);
+
+		nrf24_get_fifo_status(&fifo);
 	}
 
-	return nrf24_set_dynpd(cmd);
+	ack_service();
+	return count;
 }
 
-uint8_t set_features()
+// move every payload waiting in the receive FIFO into the receive ring.
+// returns the number of frames stored, with NRF24_ASYNC_SPI it returns 0 at once
+// and the SPI interrupt stores the frames while the caller carries on.
+uint8_t cgrf_rx_ring_fill()
 {
-	uint8_t cmd = 0x00;
-	
-	if (m_payload_length == dynamic_length)
-	{
-		cmd |= FEATURE_EN_DPL;
-	}
-	
-	if (m_auto_ack == auto_acknowledgment)
-	{
-		cmd |= FEATURE_EN_ACK_PAY;
-	}
+#ifdef NRF24_ASYNC_SPI
+	// the SPI interrupt moves the payloads, start a chain unless one is running
+	// or restart one that stopped on a full SPI queue, and return while it runs.
+	uint8_t sreg = SREG;
+	cli();
+	ring_start();
+	SREG = sreg;
+
+	ack_service();
+	return 0;
+#else
+	PROFILE_START(profile_rf_receive);
+
+	uint8_t count = 0;
+	uint8_t fifo = 0;
 	
-	if (m_payload_length == dynamic_length && m_auto_ack == auto_acknowledgment)
+	nrf24_get_fifo_status(&fifo);
+
+	if (fifo & FIFO_RX_FULL)
+		m_stats.rx_fifo_full++;
+
+	while (1)
 	{
-		cmd |= FEATURE_EN_DYN_ACK;
-	}
-	
-	// Enable dynamically sized payloads, ACK payloads, and TX support with or without an ACK request.
-	return nrf24_set_feature(cmd);
-}
+		if (fifo & FIFO_RX_EMPTY)
+		{
+			// Note: write one to clear the bit.
+			nrf24_set_status(STATUS_RX_DR);
 
-uint8_t set_payload1_size()
+			// a payload arriving before the flag was cleared would not raise it again.
+			nrf24_get_fifo_status(&fifo);
+
+			if (fifo & FIFO_RX_EMPTY)
+				break;
+		}
+
+		uint8_t plsize = 0;
+		uint8_t status = nrf24_get_payload_size(&plsize);
+		uint8_t pipe = (status & STATUS_RX_P_NO) >> 1;
+
+		plsize = payload_width(pipe, plsize);
+
+		// a width greater than 32 is corrupt and the FIFO must be flushed.
+		if (plsize > MAX_PAYLOAD_SIZE)
+		{
+			m_stats.corrupt++;
+			nrf24_flush_rx();
+			fifo = FIFO_RX_EMPTY;
+			continue;
+		}
+
+		// read straight into the free slot, or discard when the ring is full.
+		cgrf_frame_t * frame = ring_reserve();
+		nrf24_get_payload((frame != 0) ? &frame->data[0] : 0, plsize);
+
+		if (frame != 0)
+		{
+			ring_commit(pipe, plsize);
+			count++;
+		}
+
+		nrf24_get_fifo_status(&fifo);
+	}
+
+	ack_service();
+
+	PROFILE_STOP(profile_rf_receive);
+	return count;
+#endif
+}
+
+#ifdef NRF24_ASYNC_SPI
+
+// Interrupt fed receive ring
+// --------------------------
+// cgrf_rx_ring_fill(), or the IRQ routine once it latches RX_DR, calls ring_start(),
+// which queues a chain of SPI transactions that run from the SPI interrupt:
+//   FIFO_STATUS -> R_RX_PL_WID -> R_RX_PAYLOAD into the free slot -> R_RX_PL_WID ...
+// until the STATUS shifted out with R_RX_PL_WID shows the FIFO is empty.
+// FIFO_STATUS is read once at the start of each chain for the RX_FULL counter.
+// without the IRQ routine the chain clears RX_DR itself and looks once more.
+
+static volatile uint8_t m_ring_busy = 0;
+static uint8_t m_ring_width = 0;
+static uint8_t m_ring_pipe = 0;
+static uint8_t m_ring_reserved = 0;
+static uint8_t m_ring_fifo = 0;
+static uint8_t m_ring_cleared = 0;
+
+void ring_fifo_read(nrf24_transaction_t * transaction);
+void ring_width_read(nrf24_transaction_t * transaction);
+void ring_payload_read(nrf24_transaction_t * transaction);
+void ring_status_write(nrf24_transaction_t * transaction);
+
+static nrf24_transaction_t m_ring_fifo_read = { R_REGISTER | RMAP_FIFO_STATUS, 0, &m_ring_fifo, 1, ring_fifo_read, 0, 0 };
+static nrf24_transaction_t m_ring_width_read = { R_RX_PL_WID, 0, &m_ring_width, 1, ring_width_read, 0, 0 };
+static nrf24_transaction_t m_ring_payload_read = { R_RX_PAYLOAD, 0, 0, 0, ring_payload_read, 0, 0 };
+static nrf24_transaction_t m_ring_flush = { FLUSH_RX, 0, 0, 0, ring_payload_read, 0, 0 };
+
+#ifndef NRF24_IRQ_ENABLED
+static uint8_t const m_ring_rx_dr = STATUS_RX_DR;
+static nrf24_transaction_t m_ring_clear = { W_REGISTER | RMAP_STATUS, &m_ring_rx_dr, 0, 1, ring_status_write, 0, 0 };
+#endif
+
+// read the width of the payload at the top of the FIFO.
+void ring_next()
+{
+	if (!nrf24_submit(&m_ring_width_read))
+		m_ring_busy = 0;
+}
+
+void ring_fifo_read(nrf24_transaction_t * transaction)
+{
+	if (m_ring_fifo & FIFO_RX_FULL)
+		m_stats.rx_fifo_full++;
+
+	ring_next();
+}
+
+void ring_width_read(nrf24_transaction_t * transaction)
+{
+	uint8_t pipe = (transaction->status & STATUS_RX_P_NO) >> 1;
+
+	// the pipe number reads 7 when the FIFO is empty.
+	if (pipe == 7)
+	{
+#ifdef NRF24_IRQ_ENABLED
+		// the IRQ routine cleared RX_DR on the chip when it latched it.
+		nrf24_irq_clear(STATUS_RX_DR);
+		m_ring_busy = 0;
+#else
+		// Note: write one to clear the bit, then look again, as a payload arriving
+		// before the flag was cleared would not raise it again.
+		if (m_ring_cleared || !nrf24_submit(&m_ring_clear))
+			m_ring_busy = 0;
+
+		m_ring_cleared = 1;
+#endif
+		return;
+	}
+
+	m_ring_cleared = 0;
+
+	uint8_t plsize = payload_width(pipe, m_ring_width);
+
+	// a width greater than 32 is corrupt and the FIFO must be flushed.
+	if (plsize > MAX_PAYLOAD_SIZE)
+	{
+		m_stats.corrupt++;
+		m_ring_reserved = 0;
+
+		if (!nrf24_submit(&m_ring_flush))
+			m_ring_busy = 0;
+
+		return;
+	}
+
+	// read straight into the free slot, or discard when the ring is full.
+	cgrf_frame_t * frame = ring_reserve();
+
+	m_ring_pipe = pipe;
+	m_ring_reserved = (frame != 0);
+	m_ring_payload_read.rx = (frame != 0) ? &frame->data[0] : 0;
+	m_ring_payload_read.size = plsize;
+
+	if (!nrf24_submit(&m_ring_payload_read))
+		m_ring_busy = 0;
+}
+
+void ring_payload_read(nrf24_transaction_t * transaction)
+{
+	if (m_ring_reserved)
+		ring_commit(m_ring_pipe, transaction->size);
+
+	ring_next();
+}
+
+void ring_status_write(nrf24_transaction_t * transaction)
+{
+	ring_next();
+}
+
+// start a chain unless one is running, called with interrupts disabled.
+void ring_start()
+{
+	if (!m_ring_busy)
+	{
+		m_ring_busy = 1;
+		m_ring_cleared = 0;
+
+		if (!nrf24_submit(&m_ring_fifo_read))
+			m_ring_busy = 0;
+	}
+}
+
+#ifdef NRF24_IRQ_ENABLED
+
+// called from the IRQ routine with the latched STATUS bits.
+void ring_irq(uint8_t const flags)
+{
+	if (flags & STATUS_RX_DR)
+		ring_start();
+}
+
+// fill the receive ring from the radio interrupt instead of cgrf_rx_ring_fill().
+void cgrf_rx_ring_fill_from_irq(uint8_t const enable)
+{
+	nrf24_set_irq_callback(enable ? ring_irq : 0);
+
+	// collect anything that arrived before the callback was set.
+	if (enable)
+	{
+		uint8_t sreg = SREG;
+		cli();
+		ring_start();
+		SREG = sreg;
+	}
+}
+
+#endif
+
+#endif
+
+// returns the oldest frame in the receive ring, or 0 if the ring is empty.
+// the frame stays in its slot until cgrf_rx_release() is called.
+cgrf_frame_t const * cgrf_rx_peek()
+{
+	uint8_t head = m_ring_head;
+
+	if (head == m_ring_tail)
+		return 0;
+
+	return &m_ring[head & (CGRF_RX_RING_SIZE - 1)];
+}
+
+// release the oldest frame, freeing its slot.
+void cgrf_rx_release()
+{
+	if (m_ring_head != m_ring_tail)
+		m_ring_head++;
+
+	ack_service();
+}
+
+// get the receive ring counters.
+void cgrf_rx_ring_stats(cgrf_ring_stats_t * stats)
+{
+	uint8_t sreg = SREG;
+	cli();
+	*stats = m_ring_stats;
+	SREG = sreg;
+}
+
+// reset the receive ring counters.
+void cgrf_rx_ring_reset_stats()
+{
+	uint8_t sreg = SREG;
+	cli();
+	m_ring_stats.frames = 0;
+	m_ring_stats.overflows = 0;
+	m_ring_stats.high_water = 0;
+	SREG = sreg;
+}
+
+// sample carrier detect (RPD) on every channel, adding the hits to the survey occupancy.
+// the radio must be powered up as a receiver, profile_channel_scan is intended for this.
+// writes up to count of the quietest channels, quietest first, and returns the number written.
+uint8_t cgrf_survey(cgrf_survey_t * survey, uint8_t const samples, uint8_t * quietest, uint8_t const count)
+{
+	uint8_t cd = 0;
+
+	for (uint8_t channel = 0; channel < CGRF_SURVEY_CHANNELS; channel++)
+	{
+		// RPD is only latched again after RX mode is re-entered on the new channel.
+		nrf24_set_ce_low();
+		nrf24_set_rf_ch(channel);
+		nrf24_set_ce_high();
+		_delay_us(RPD_SETTLE_US);
+
+		uint8_t hits = 0;
+
+		// the SPI read itself spaces the samples.
+		for (uint8_t n = 0; n < samples; n++)
+		{
+			nrf24_get_cd(&cd);
+
+			if (cd & 0x01)
+				hits++;
+		}
+
+		survey_add(survey, channel, hits);
+	}
+
+	// back to the configured channel.
+	nrf24_set_ce_low();
+	nrf24_set_rf_ch(m_channel);
+
+	cgrf_restore_ce();
+
+	// pick the quietest channels, lowest score first, each channel once.
+	uint8_t written = 0;
+
+	while (written < count)
+	{
+		uint8_t best = 0xFF;
+		uint8_t best_score = 0xFF;
+
+		for (uint8_t channel = 0; channel < CGRF_SURVEY_CHANNELS; channel++)
+		{
+			uint8_t taken = 0;
+
+			for (uint8_t i = 0; i < written; i++)
+			{
+				if (quietest[i] == channel)
+					taken = 1;
+			}
+
+			if (taken)
+				continue;
+
+			uint8_t score = survey_score(survey, channel);
+
+			if (score < best_score)
+			{
+				best = channel;
+				best_score = score;
+			}
+		}
+
+		if (best == 0xFF)
+			break;
+
+		quietest[written++] = best;
+	}
+
+	return written;
+}
+
+// returns the occupancy count of a surveyed channel.
+uint8_t cgrf_survey_occupancy(cgrf_survey_t const * const survey, uint8_t const channel)
+{
+	if (channel >= CGRF_SURVEY_CHANNELS)
+		return 0;
+
+	uint8_t value = survey->occupancy[channel >> 1];
+
+	return (channel & 0x01) ? (value >> 4) : (value & 0x0F);
+}
+
+// start hopping over a seeded pseudo-random order of the given channels, changing channel every interval.
+// both ends must use the same seed, channels and interval. the transmitter sets the slot timing,
+// the receiver waits on one channel until it hears the transmitter, then follows it.
+// requires clock_init(), returns 0 if the channels or interval are not valid.
+uint8_t cgrf_hop_begin(uint16_t const seed, uint8_t const * const channels, uint8_t const count, uint16_t const interval_ms)
+{
+	if (count < 2 || count > CGRF_HOP_MAX_CHANNELS || interval_ms < 2)
+		return 0;
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		if (channels[i] > 125)
+			return 0;
+	}
+
+	m_hop_count = 0;
+	memcpy(m_hop_sequence, channels, count);
+
+	// shuffle with a 16 bit xorshift generator, the same seed gives the same order on both ends.
+	// each channel appears once per cycle, so a receiver knows the slot from the channel it heard.
+	uint16_t x = (seed != 0) ? seed : 1;
+
+	for (uint8_t i = count - 1; i > 0; i--)
+	{
+		x ^= x << 7;
+		x ^= x >> 9;
+		x ^= x << 8;
+
+		uint8_t j = x % (i + 1);
+		uint8_t channel = m_hop_sequence[i];
+		m_hop_sequence[i] = m_hop_sequence[j];
+		m_hop_sequence[j] = channel;
+	}
+
+	memset(m_hop_strikes, 0, sizeof(m_hop_strikes));
+	memset(m_hop_penalty, 0, sizeof(m_hop_penalty));
+
+	m_hop_index = 0;
+	m_hop_interval = interval_ms;
+	m_hop_synchronised = (m_mode == transmitter);
+	m_hop_silent = 0;
+	m_hop_heard_in_slot = 0;
+	m_hop_heard = 0;
+	m_hop_hops = 0;
+	m_hop_resyncs = 0;
+	m_hop_slot_start = clock_millis();
+	m_hop_count = count;
+
+	hop_tune();
+	return 1;
+}
+
+// stop hopping and stay on the current channel.
+void cgrf_hop_end()
+{
+	m_hop_count = 0;
+
+	// a receiver may have been sleeping through a blacklisted channel.
+	cgrf_restore_ce();
+}
+
+// follow the hopping sequence, call from the main loop.
+// returns 1 when a new slot has started, the transmitter should send early in the slot.
+uint8_t cgrf_hop_update()
+{
+	if (m_hop_count == 0)
+		return 0;
+
+	if (m_mode == reciever)
+	{
+		uint8_t sreg = SREG;
+		cli();
+		uint8_t heard = m_hop_heard;
+		uint32_t heard_at = m_hop_heard_at;
+		m_hop_heard = 0;
+		SREG = sreg;
+
+		if (heard)
+			hop_resync(heard_at);
+
+		// wait on the current channel until the transmitter comes round to it.
+		if (!m_hop_synchronised)
+			return 0;
+	}
+	else if (m_send.result == send_in_progress)
+	{
+		// the channel must not change under a send.
+		return 0;
+	}
+	else if (m_ack_pending && cgrf_check_acknowledgment() == failed_retry_in_progress)
+	{
+		// nor under a blocking send that is still retrying.
+		return 0;
+	}
+
+	if (clock_elapsed(m_hop_slot_start) < m_hop_interval)
+		return 0;
+
+	if (m_mode == reciever)
+	{
+		// a slot the transmitter was silent in counts against the channel.
+		if (m_hop_penalty[m_hop_index] == 0)
+			hop_strike(!m_hop_heard_in_slot);
+
+		if (m_hop_heard_in_slot)
+		{
+			m_hop_silent = 0;
+		}
+		else if (++m_hop_silent >= 2 * m_hop_count)
+		{
+			// nothing heard for two cycles, wait for the transmitter again.
+			m_hop_synchronised = 0;
+			m_hop_silent = 0;
+			hop_tune();
+			return 0;
+		}
+	}
+
+	m_hop_heard_in_slot = 0;
+
+	// move on, catching up any slots missed between updates.
+	do
+	{
+		if (m_hop_penalty[m_hop_index] != 0)
+			m_hop_penalty[m_hop_index]--;
+
+		m_hop_index++;
+
+		if (m_hop_index == m_hop_count)
+			m_hop_index = 0;
+
+		m_hop_slot_start += m_hop_interval;
+	}
+	while (clock_elapsed(m_hop_slot_start) >= m_hop_interval);
+
+	hop_tune();
+	m_hop_hops++;
+
+	return 1;
+}
+
+// returns 0 if the current channel is blacklisted and the transmitter should hold its sends.
+uint8_t cgrf_hop_clear_to_send()
+{
+	return m_hop_count == 0 || m_hop_penalty[m_hop_index] == 0;
+}
+
+// get the frequency hopping state.
+void cgrf_hop_get_status(cgrf_hop_status_t * status)
+{
+	status->channel = m_channel;
+	status->synchronised = m_hop_synchronised;
+	status->blacklisted = hop_blacklisted();
+	status->hops = m_hop_hops;
+	status->resyncs = m_hop_resyncs;
+}
+
+// the outcome of a blocking send that was still retrying is counted in the link stats once it is seen.
+acknowledgment_t cgrf_check_acknowledgment()
+{
+	uint8_t status = 0;
+	nrf24_get_status(&status);
+
+	acknowledgment_t ack = failed_retry_in_progress;
+
+	// auto acknowledgment received.
+	if (status & STATUS_TX_DS)
+		ack = success;
+
+	else if (status & STATUS_MAX_RT)
+		ack = failed;
+
+	count_acknowledgment(ack);
+	return ack;
+}
+
+// private functions...
+//
+
+// account for the payloads the chip has finished with since the last update.
+// returns the status.
+uint8_t stream_update()
+{
+	uint8_t status = 0;
+	nrf24_get_status(&status);
+
+	if (status & STATUS_MAX_RT)
+	{
+		// the payload at the head of the FIFO has run out of retransmits.
+		// the chip stops until MAX_RT is cleared and the FIFO can only be flushed
+		// as a whole, so the payloads still in the FIFO are dropped. those in flight
+		// that have already left it were delivered.
+		uint8_t fifo = 0;
+		nrf24_get_fifo_status(&fifo);
+
+		// the failed payload is still in the FIFO, a partly full FIFO holds one or two,
+		// one fewer when TX_DS shows a payload has gone since the last update.
+		uint8_t waiting = 1;
+
+		if (fifo & FIFO_TX_FULL)
+			waiting = 3;
+		else if (m_stream_in_flight > 1 && !(status & STATUS_TX_DS))
+			waiting = 2;
+
+		if (waiting > m_stream_in_flight)
+			waiting = m_stream_in_flight;
+
+		uint8_t sent = m_stream_in_flight - waiting;
+
+		nrf24_flush_tx();
+		m_stream.delivered += sent;
+		m_stream.failed += waiting;
+		m_stream_in_flight = 0;
+
+		m_stats.sent += sent;
+		count_delivered(m_stream_delivery, sent);
+
+		// the payload that ran out counts as one send, the others never went.
+		uint8_t observe = 0;
+		nrf24_get_observe_tx(&observe);
+		count_send(send_max_retries, observe & OBSERVE_ARC_CNT);
+
+		// Note: write one to clear the bit.
+		nrf24_set_status(STATUS_TX_DS | STATUS_MAX_RT);
+		return status & ~STATUS_TX_FIFO_FULL;
+	}
+
+	if (status & STATUS_TX_DS)
+	{
+		// Note: write one to clear the bit.
+		nrf24_set_status(STATUS_TX_DS);
+	}
+
+	uint8_t fifo = 0;
+	nrf24_get_fifo_status(&fifo);
+	uint8_t sent = 0;
+
+	if (fifo & FIFO_TX_EMPTY)
+	{
+		sent = m_stream_in_flight;
+	}
+	else if (fifo & FIFO_TX_FULL)
+	{
+		// three payloads are waiting, the rest have gone.
+		if (m_stream_in_flight > 3)
+			sent = m_stream_in_flight - 3;
+	}
+	else if ((status & STATUS_TX_DS) && m_stream_in_flight > 1)
+	{
+		// at least one payload has gone since the last update.
+		sent = 1;
+	}
+
+	m_stream.delivered += sent;
+	m_stream_in_flight -= sent;
+
+	if (sent != 0 || m_stream_in_flight == 0)
+	{
+		m_stream_progress = clock_millis();
+	}
+	else if (clock_elapsed(m_stream_progress) >= CGRF_SEND_TIMEOUT_MS)
+	{
+		// the chip has stopped sending, the payloads still in flight are dropped.
+		nrf24_flush_tx();
+		m_stream.failed += m_stream_in_flight;
+		m_stream_in_flight = 0;
+		m_stats.timeouts++;
+
+		return status & ~STATUS_TX_FIFO_FULL;
+	}
+
+	// ARC_CNT only describes the last payload, so the stream does not add to the histogram.
+	m_stats.sent += sent;
+	count_delivered(m_stream_delivery, sent);
+
+	return status;
+}
+
+// returns the width of the payload received on the given pipe,
+// the width read with R_RX_PL_WID for dynamic length or the pipe width for static length.
+uint8_t payload_width(uint8_t const pipe, uint8_t const dynamic_width)
+{
+	uint8_t dynpd = 0;
+	nrf24_get_dynpd(&dynpd);
+
+	if (pipe >= CGRF_PIPES || (dynpd & (1 << pipe)))
+		return dynamic_width;
+
+	// served from the register shadow.
+	uint8_t width = 0;
+	nrf24_get_register(RMAP_RX_PW_P0 + pipe, &width);
+
+	return width;
+}
+
+// count a received frame against its data pipe.
+void count_frame(uint8_t const pipe, uint8_t const size)
+{
+	if (pipe < CGRF_PIPES)
+	{
+		m_pipe_stats[pipe].packets++;
+		m_pipe_stats[pipe].bytes += size;
+
+		// the acknowledgment for the frame carried the payload loaded for the pipe.
+		if (m_ack_loaded & (1 << pipe))
+			m_ack_sent |= (1 << pipe);
+	}
+
+	if (m_hop_count != 0 && !m_hop_heard)
+	{
+		m_hop_heard_at = clock_millis();
+		m_hop_heard = 1;
+	}
+
+	m_stats.received++;
+
+	// the receive rate, counted over whole seconds.
+	uint32_t now = clock_millis();
+
+	if (now - m_rate_start >= 1000)
+	{
+		m_stats.rx_per_second = (now - m_rate_start < 2000) ? m_rate_count : 0;
+		m_rate_start = now;
+		m_rate_count = 0;
+	}
+
+	m_rate_count++;
+}
+
+// count a completed send and its retransmits.
+void count_send(send_result_t const result, uint8_t const retransmits)
+{
+	m_stats.sent++;
+	count_outcome(result, retransmits);
+}
+
+// count how a send ended, the send itself was counted when it started.
+void count_outcome(send_result_t const result, uint8_t const retransmits)
+{
+	if (result == send_success)
+		count_delivered(m_send_delivery, 1);
+	else if (result == send_max_retries)
+		m_stats.max_retries++;
+	else
+		m_stats.timeouts++;
+
+	m_stats.retransmits[retransmits & OBSERVE_ARC_CNT]++;
+}
+
+// count sends that ended with TX_DS, only those that asked for an acknowledgment were acknowledged.
+void count_delivered(delivery_t const delivery, uint8_t const count)
+{
+	if (delivery == delivery_acknowledged && m_auto_ack == auto_acknowledgment)
+		m_stats.acknowledged += count;
+	else
+		m_stats.unacknowledged += count;
+}
+
+// count the outcome of a blocking send, the first time it is seen.
+void count_acknowledgment(acknowledgment_t const ack)
+{
+	if (!m_ack_pending || ack == failed_retry_in_progress)
+		return;
+
+	m_ack_pending = 0;
+
+	uint8_t observe = 0;
+	nrf24_get_observe_tx(&observe);
+
+	count_outcome((ack == success) ? send_success : send_max_retries, observe & OBSERVE_ARC_CNT);
+
+	// the channel has not changed while the send was in progress.
+	if (m_hop_count != 0)
+		hop_strike(ack != success);
+}
+
+// count the outcome of the last blocking send and clear its flags before the next send,
+// a send still retrying by then is counted as a timeout.
+void settle_acknowledgment()
+{
+	if (m_ack_pending && cgrf_check_acknowledgment() == failed_retry_in_progress)
+	{
+		m_ack_pending = 0;
+		m_stats.timeouts++;
+	}
+
+	// Note: write one to clear the bit.
+	nrf24_set_status(STATUS_TX_DS | STATUS_MAX_RT);
+}
+
+// add carrier detect hits to the occupancy of a channel, saturating at 15.
+void survey_add(cgrf_survey_t * survey, uint8_t const channel, uint8_t const hits)
+{
+	uint8_t occupancy = cgrf_survey_occupancy(survey, channel) + hits;
+
+	if (occupancy > 15)
+		occupancy = 15;
+
+	uint8_t * value = &survey->occupancy[channel >> 1];
+
+	if (channel & 0x01)
+		*value = (*value & 0x0F) | (occupancy << 4);
+	else
+		*value = (*value & 0xF0) | occupancy;
+}
+
+// score a channel by its own occupancy and half that of its neighbours,
+// a Wi-Fi channel is wide enough to cover several nRF24L01+ channels.
+uint8_t survey_score(cgrf_survey_t const * const survey, uint8_t const channel)
+{
+	uint8_t score = cgrf_survey_occupancy(survey, channel) * 2;
+
+	if (channel > 0)
+		score += cgrf_survey_occupancy(survey, channel - 1);
+
+	if (channel < CGRF_SURVEY_CHANNELS - 1)
+		score += cgrf_survey_occupancy(survey, channel + 1);
+
+	return score;
+}
+
+// tune to the channel of the current slot.
+void hop_tune()
+{
+	nrf24_set_ce_low();
+	cgrf_set_channel(m_hop_sequence[m_hop_index]);
+
+	// a receiver sleeps through a blacklisted channel, unless it is still looking for the transmitter.
+	if (m_mode == reciever && m_power == on && (m_hop_penalty[m_hop_index] == 0 || !m_hop_synchronised))
+		nrf24_set_ce_high();
+}
+
+// line the receiver's slots up with the transmitter's from the time a frame was received.
+void hop_resync(uint32_t const heard_at)
+{
+	uint32_t start = heard_at - CGRF_HOP_LATENCY_MS;
+
+	if (!m_hop_synchronised)
+	{
+		// the channel heard gives the transmitter's place in the sequence.
+		m_hop_slot_start = start;
+		m_hop_synchronised = 1;
+		m_hop_silent = 0;
+		m_hop_heard_in_slot = 1;
+		m_hop_resyncs++;
+		return;
+	}
+
+	if (m_hop_heard_in_slot)
+		return;
+
+	m_hop_heard_in_slot = 1;
+
+	// move half way towards the first frame of the slot, ignoring frames too far out to be trusted.
+	int32_t error = (int32_t)(start - m_hop_slot_start);
+	int32_t limit = m_hop_interval / 2;
+
+	if (error > -limit && error < limit)
+		m_hop_slot_start += error / 2;
+}
+
+// count a failure on the current channel, blacklisting it after repeated failures.
+// the receiver sleeps through its blacklisted channels and the transmitter holds its sends, so a
+// channel blacklisted at one end soon fails at the other and both ends settle on the same channels.
+void hop_strike(uint8_t const failed)
+{
+	uint8_t i = m_hop_index;
+
+	if (!failed)
+	{
+		m_hop_strikes[i] = 0;
+		return;
+	}
+
+	if (++m_hop_strikes[i] < CGRF_HOP_STRIKES)
+		return;
+
+	m_hop_strikes[i] = 0;
+
+	if (hop_blacklisted() + CGRF_HOP_MIN_OPEN < m_hop_count)
+		m_hop_penalty[i] = CGRF_HOP_PENALTY;
+}
+
+// returns the number of channels being skipped.
+uint8_t hop_blacklisted()
+{
+	uint8_t count = 0;
+
+	for (uint8_t i = 0; i < m_hop_count; i++)
+	{
+		if (m_hop_penalty[i] != 0)
+			count++;
+	}
+
+	return count;
+}
+
+// release the acknowledgment payloads that have gone out and load the next payload for each pipe.
+// called from the main context only.
+void ack_service()
+{
+	uint8_t sreg = SREG;
+	cli();
+	uint8_t sent = m_ack_sent;
+	m_ack_sent = 0;
+	m_ack_loaded &= ~sent;
+	SREG = sreg;
+
+	uint8_t waiting = 0;
+	uint8_t loaded = 0;
+
+	for (uint8_t pipe = 0; pipe < CGRF_PIPES; pipe++)
+	{
+		uint8_t bit = (1 << pipe);
+
+		if ((sent & bit) && m_ack_head[pipe] != 0)
+		{
+			// return the slot at the head of the queue to the pool.
+			uint8_t index = m_ack_head[pipe] - 1;
+			m_ack_head[pipe] = m_ack_pool[index].next;
+
+			if (m_ack_head[pipe] == 0)
+				m_ack_tail[pipe] = 0;
+
+			m_ack_used &= ~(1 << index);
+		}
+
+		if (m_ack_loaded & bit)
+			loaded++;
+		else if (m_ack_head[pipe] != 0)
+			waiting |= bit;
+	}
+
+	// a receiver turned round to send would send them as ordinary payloads.
+	if (waiting == 0 || m_mode != reciever)
+		return;
+
+	// a frame still in the RX FIFO could be taken for the reply to a payload loaded now,
+	// so only load once every received frame has been counted.
+	uint8_t fifo = 0;
+	nrf24_get_fifo_status(&fifo);
+
+	if (!(fifo & FIFO_RX_EMPTY))
+		return;
+
+	// the TX FIFO holds three payloads, one per pipe keeps a quiet node from blocking the others.
+	for (uint8_t pipe = 0; pipe < CGRF_PIPES && loaded < 3; pipe++)
+	{
+		if (waiting & (1 << pipe))
+		{
+			ack_slot_t const * slot = &m_ack_pool[m_ack_head[pipe] - 1];
+			nrf24_load_ack_payload(pipe, slot->data, slot->size);
+			m_ack_loaded |= (1 << pipe);
+			loaded++;
+		}
+	}
+}
+
+// write the payload and pulse CE, with or without asking for an acknowledgment.
+void send_payload(uint8_t const * const data, uint8_t const size, delivery_t const delivery)
+{
+	PROFILE_START(profile_rf_send);
+
+	m_send_delivery = delivery;
+
+	if (delivery == delivery_unacknowledged)
+	{
+		enable_dynamic_ack();
+		nrf24_transmit_data_no_ack(standby_II_fast_start, data, size);
+	}
+	else
+	{
+		nrf24_transmit_data(standby_II_fast_start, data, size);
+	}
+
+	PROFILE_STOP(profile_rf_send);
+}
+
+// set EN_DYN_ACK, W_TX_PAYLOAD_NOACK is ignored without it.
+// the shadow makes this a no-op once it has been written.
+void enable_dynamic_ack()
+{
+	uint8_t feature = 0;
+	nrf24_get_feature(&feature);
+	nrf24_update_register(RMAP_FEATURE, feature | FEATURE_EN_DYN_ACK);
+}
+
+// pass the payloads that came back with an acknowledgment to the callback.
+void ack_deliver()
+{
+	if (m_ack_callback == 0)
+		return;
+
+	uint8_t status = 0;
+	nrf24_get_status(&status);
+
+	if (status & STATUS_RX_DR)
+		cgrf_drain_rx(m_ack_callback);
+}
+
+// set or clear the bit for a data pipe in EN_AA, EN_RXADDR or DYNPD.
+void update_pipe_bit(uint8_t const reg_map_addr, uint8_t const pipe, uint8_t const set)
+{
+	uint8_t value = 0;
+	nrf24_get_register(reg_map_addr, &value);
+
+	if (set)
+		value |= (1 << pipe);
+	else
+		value &= ~(1 << pipe);
+
+	nrf24_update_register(reg_map_addr, value);
+}
+
+// returns the free slot at the tail of the receive ring,
+// or 0 and counts an overflow when the ring is full.
+// the caller must still read the payload, with no buffer, to pop it from the FIFO.
+cgrf_frame_t * ring_reserve()
+{
+	uint8_t tail = m_ring_tail;
+
+	if ((uint8_t)(tail - m_ring_head) == CGRF_RX_RING_SIZE)
+	{
+		m_ring_stats.overflows++;
+		m_stats.dropped++;
+		return 0;
+	}
+
+	return &m_ring[tail & (CGRF_RX_RING_SIZE - 1)];
+}
+
+// complete the frame in the reserved slot and hand it to the consumer.
+void ring_commit(uint8_t const pipe, uint8_t const size)
+{
+	uint8_t tail = m_ring_tail;
+	cgrf_frame_t * frame = &m_ring[tail & (CGRF_RX_RING_SIZE - 1)];
+
+	frame->size = size;
+	frame->pipe = pipe;
+	frame->timestamp = (uint16_t)clock_millis();
+
+	m_ring_tail = tail + 1;
+	m_ring_stats.frames++;
+	count_frame(pipe, size);
+
+	uint8_t used = m_ring_tail - m_ring_head;
+
+	if (used > m_ring_stats.high_water)
+		m_ring_stats.high_water = used;
+}
+
+// apply a profile, then put back the settings made with the cgrf_set_* functions.
+// the defaults of the settings are the profile values, so by default nothing more is written.
+void start_profile(cgrf_profile_t const profile)
+{
+	crc_encoding_t crc = m_crc_encoding;
+	air_data_rate_t data_rate = m_data_rate;
+	rf_output_power_t output_power = m_output_power;
+	auto_ack_t ack = m_auto_ack;
+	payload_length_t length = m_payload_length;
+	uint8_t size = m_payload_size;
+
+	cgrf_apply_profile(profile);
+
+	// registers must only be changed in power down or standby.
+	nrf24_set_ce_low();
+
+	cgrf_set_crc_encoding(crc);
+	cgrf_set_data_rate(data_rate);
+	cgrf_set_output_power(output_power);
+	cgrf_set_acknowledgment(ack);
+	cgrf_set_length(length, size);
+
+	cgrf_restore_ce();
+}
+
+// follow the settings held in the registers after a profile has been applied.
+void read_settings()
+{
+	uint8_t value = 0;
+
+	nrf24_get_config(&value);
+
+	if (!(value & CONFIG_ENABLE_CRC))
+		m_crc_encoding = crc_none;
+	else if (value & CONFIG_CRC_2BYTES)
+		m_crc_encoding = crc_2_bytes;
+	else
+		m_crc_encoding = crc_1_byte;
+
+	m_power = (value & CONFIG_PWR_UP) ? on : off;
+	m_mode = (value & CONFIG_PRIM_PRX) ? reciever : transmitter;
+
+	// the global settings are those of data pipes 0 and 1.
+	nrf24_get_en_aa(&value);
+	m_auto_ack = (value & (ENAA_P0 | ENAA_P1)) ? auto_acknowledgment : no_acknowledgment;
+
+	nrf24_get_dynpd(&value);
+	m_payload_length = (value & (DPL_P0 | DPL_P1)) ? dynamic_length : static_length;
+
+	nrf24_get_rx_pw_p1(&m_payload_size);
+
+	nrf24_get_rf_setup(&value);
+	if (value & RF_DR_250KBPS)
+		m_data_rate = data_rate_250_kbps;
+	else if (value & RF_DR_2MBPS)
+		m_data_rate = data_rate_2_mbps;
+	else
+		m_data_rate = data_rate_1_mbps;
+
+	switch (value & RF_PWR_0DBM)
+	{
+		case RF_PWR_MINUS_18DBM: m_output_power = power_minus_18dbm; break;
+		case RF_PWR_MINUS_12DBM: m_output_power = power_minus_12dbm; break;
+		case RF_PWR_MINUS_6DBM:  m_output_power = power_minus_6dbm; break;
+		default:                 m_output_power = power_0dbm; break;
+	}
+}
+
+uint8_t set_auto_ack()
+{
+	// pipes 2 to 5 are set by cgrf_set_pipe_acknowledgment() and cgrf_set_pipe_length(), keep them.
+	uint8_t cmd = 0x00;
+	nrf24_get_en_aa(&cmd);
+	cmd &= ~(ENAA_P0 | ENAA_P1);
+	
+	if (m_auto_ack == auto_acknowledgment)
+		cmd |= ENAA_P0 | ENAA_P1;
+
+	// enable auto acknowledgment (enhanced ShockBurst) for data pipes 0 and 1.
+	return nrf24_set_en_aa(cmd);
+}
+
+
+uint8_t set_dynamic_payload()
+{
+	// pipes 2 to 5 are set by cgrf_set_pipe_length(), keep them.
+	uint8_t cmd = 0x00;
+	nrf24_get_dynpd(&cmd);
+	cmd &= ~(DPL_P0 | DPL_P1);
+
+	if (m_payload_length == dynamic_length)
+	{
+		// Enable dynamically sized packets on the 2 RX pipes we use, 0 and 1.
+		// RX pipe address 1 is used to for normal packets from radios that send us data.
+		// RX pipe address 0 is used to for auto-acknowledgment packets from radios we transmit to.
+		cmd |= DPL_P0 | DPL_P1;
+	}
+
+	return nrf24_set_dynpd(cmd);
+}
+
+uint8_t set_features()
+{
+	uint8_t cmd = 0x00;
+	uint8_t dynpd = 0;
+	nrf24_get_dynpd(&dynpd);
+	
+	// a pipe set to dynamic length by cgrf_set_pipe_length() also needs EN_DPL.
+	if (m_payload_length == dynamic_length || dynpd != 0)
+	{
+		cmd |= FEATURE_EN_DPL;
+	}
+	
+	if (m_auto_ack == auto_acknowledgment)
+	{
+		cmd |= FEATURE_EN_ACK_PAY;
+	}
+	
+	if (m_payload_length == dynamic_length && m_auto_ack == auto_acknowledgment)
+	{
+		cmd |= FEATURE_EN_DYN_ACK;
+	}
+	
+	// Enable dynamically sized payloads, ACK payloads, and TX support with or without an ACK request.
+	return nrf24_set_feature(cmd);
+}
+
+uint8_t set_payload1_size()
 {
 	// number of bytes in RX payload for data pipe.
 	return nrf24_set_rx_pw_p1(m_payload_size);
@@ -545,6 +2243,9 @@ uint8_t set_rf_setup()
 		
 	else if (m_data_rate == data_rate_2_mbps)
 		cmd |= RF_DR_2MBPS;
+
+	else if (m_data_rate == data_rate_250_kbps)
+		cmd |= RF_DR_250KBPS;
 	
 	// RF output power.
 	if (m_output_power == power_minus_18dbm)
@@ -6,14 +6,19 @@
  */ 
 
 #include <stdint.h>
+#include "nrf24l01.h"
 
 #ifndef CGRF_H_
 #define CGRF_H_
 
+// number of frame slots in the receive ring (power of 2).
+#define CGRF_RX_RING_SIZE 4
+
 typedef enum
 {
 	data_rate_1_mbps,
 	data_rate_2_mbps,
+	data_rate_250_kbps,
 } air_data_rate_t;
 
 typedef enum
@@ -50,7 +55,138 @@ typedef enum
 	failed_retry_in_progress,
 } acknowledgment_t;
 
-// initialise the nRF24L01+ module ports.
+// delivery class of a transmitted payload.
+typedef enum
+{
+	delivery_acknowledged,
+	delivery_unacknowledged,
+} delivery_t;
+
+typedef enum
+{
+	profile_transmitter,
+	profile_receiver,
+	profile_channel_scan,
+	profile_low_power_beacon,
+} cgrf_profile_t;
+
+typedef enum
+{
+	send_idle,
+	send_in_progress,
+	send_success,
+	send_max_retries,
+	send_timeout,
+} send_result_t;
+
+// outcome of an asynchronous send.
+typedef struct
+{
+	uint8_t ticket;			// ticket returned by cgrf_send_async().
+	send_result_t result;
+	uint8_t retransmits;	// ARC_CNT from OBSERVE_TX.
+} cgrf_send_report_t;
+
+// called by cgrf_poll() once a send completes.
+typedef void (*cgrf_send_callback_t)(cgrf_send_report_t const * const report);
+
+// payload counts for a transmit stream.
+typedef struct
+{
+	uint16_t queued;		// payloads written to the TX FIFO.
+	uint16_t delivered;		// payloads sent, and acknowledged when auto acknowledgment is on.
+	uint16_t failed;		// payloads dropped after the maximum number of retransmits.
+} cgrf_stream_t;
+
+// number of receive data pipes.
+#define CGRF_PIPES 6
+
+// receive counters for a data pipe.
+typedef struct
+{
+	uint16_t packets;
+	uint32_t bytes;
+} cgrf_pipe_stats_t;
+
+// payloads that can wait to be sent back with an acknowledgment, shared by every data pipe.
+#define CGRF_ACK_POOL_SIZE 4
+
+// largest number of channels in a hopping sequence.
+#define CGRF_HOP_MAX_CHANNELS 16
+
+// failures on a channel before it is blacklisted.
+#define CGRF_HOP_STRIKES 3
+
+// visits a blacklisted channel is skipped for before it is tried again.
+#define CGRF_HOP_PENALTY 8
+
+// channels that are never blacklisted, so the link always has somewhere to go.
+#define CGRF_HOP_MIN_OPEN 2
+
+// milliseconds from the start of a transmitter slot to its first frame being read by the receiver.
+#define CGRF_HOP_LATENCY_MS 1
+
+// frequency hopping state.
+typedef struct
+{
+	uint8_t channel;
+	uint8_t synchronised;
+	uint8_t blacklisted;	// channels being skipped.
+	uint16_t hops;
+	uint16_t resyncs;
+} cgrf_hop_status_t;
+
+// channels covered by a survey, 0 to 125.
+#define CGRF_SURVEY_CHANNELS 126
+
+// carrier detect occupancy of every channel, two channels per byte,
+// even channels in the low nibble. each count is saturated at 15.
+typedef struct
+{
+	uint8_t occupancy[CGRF_SURVEY_CHANNELS / 2];
+} cgrf_survey_t;
+
+// received frame held in a receive ring slot.
+typedef struct
+{
+	uint8_t size;			// payload size in bytes.
+	uint8_t pipe;			// data pipe the payload arrived on.
+	uint16_t timestamp;		// clock_millis() modulo 65536 when the payload was read from the FIFO.
+	uint8_t data[32];
+} cgrf_frame_t;
+
+// retransmit histogram bins, one for each ARC_CNT value.
+#define CGRF_RETRANSMIT_BINS 16
+
+// link counters, kept on the send and receive paths.
+typedef struct
+{
+	uint16_t sent;				// sends, a blocking send is counted when it starts.
+	uint16_t acknowledged;		// sends that asked for an acknowledgment ending with TX_DS.
+	uint16_t unacknowledged;	// sends that did not ask for an acknowledgment ending with TX_DS.
+	uint16_t max_retries;		// sends ending with MAX_RT.
+	uint16_t timeouts;			// sends abandoned without either, or blocking sends still retrying when the next began.
+	uint16_t retransmits[CGRF_RETRANSMIT_BINS];	// completed sends by their ARC_CNT.
+	uint16_t received;			// payloads read from the RX FIFO.
+	uint16_t rx_fifo_full;		// times the RX FIFO was found full, a payload arriving then is lost.
+	uint16_t corrupt;			// payload widths over 32 bytes, flushed with the RX FIFO.
+	uint16_t dropped;			// payloads read from the RX FIFO and discarded because the receive ring was full.
+	uint16_t rx_per_second;		// payloads received in the last whole second.
+} cgrf_stats_t;
+
+// receive ring counters.
+typedef struct
+{
+	uint16_t frames;		// frames stored in the ring.
+	uint16_t overflows;		// frames discarded because the ring was full.
+	uint8_t high_water;		// most slots ever in use at once.
+} cgrf_ring_stats_t;
+
+// called for each payload read from the receive FIFO.
+typedef void (*cgrf_rx_callback_t)(uint8_t const pipe, uint8_t const * const data, uint8_t const size);
+
+// initialise the nRF24L01+ module ports and load the register shadow.
+// waits 100 ms for the chip's power on reset first.
 void cgrf_init();
 
 // set the channel.
@@ -62,38 +198,177 @@ void cgrf_set_data_rate(air_data_rate_t const data_rate);
 // set the RF output power.
 void cgrf_set_output_power(rf_output_power_t const output_power);
 
+// set the auto retransmit delay in 250 us steps (0 = 250 us to 15 = 4000 us) and count (0 to 15).
+void cgrf_set_retransmit(uint8_t const delay, uint8_t const count);
+
+// set CE high again after settings were changed in standby, if the radio is a powered up receiver.
+void cgrf_restore_ce();
+
 // set the cyclic encoding scheme.
 void cgrf_set_crc_encoding(crc_encoding_t const crc);
 
-// set the auto acknowledgment.
+// set the auto acknowledgment of data pipes 0 and 1, pipes 2 to 5 keep their own.
 void cgrf_set_acknowledgment(auto_ack_t const ack);
 
-// set the payload length.
+// set the payload length of data pipes 0 and 1, pipes 2 to 5 keep their own.
 void cgrf_set_length(payload_length_t const length, uint8_t const size);
 
+// enable or disable receive data pipe 0 to 5.
+void cgrf_enable_pipe(uint8_t const pipe, uint8_t const enable);
+
+// set the least significant address byte of data pipe 2 to 5.
+// the other address bytes are shared with data pipe 1.
+void cgrf_set_pipe_address(uint8_t const pipe, uint8_t const lsb);
+
+// set the payload length of data pipe 0 to 5, size is used for static length.
+// dynamic length also turns on the pipe's auto acknowledgment, which the chip requires.
+void cgrf_set_pipe_length(uint8_t const pipe, payload_length_t const length, uint8_t const size);
+
+// set the auto acknowledgment of data pipe 0 to 5.
+void cgrf_set_pipe_acknowledgment(uint8_t const pipe, auto_ack_t const ack);
+
+// get a snapshot of the link counters.
+void cgrf_get_stats(cgrf_stats_t * stats);
+
+// reset the link counters.
+void cgrf_reset_stats();
+
+// get the receive counters of data pipe 0 to 5.
+void cgrf_get_pipe_stats(uint8_t const pipe, cgrf_pipe_stats_t * stats);
+
+// reset the receive counters of every data pipe.
+void cgrf_reset_pipe_stats();
+
 // set the transmit destination address.
 void cgrf_set_tx_address(uint8_t address[5]);
 
 // setup as a transmitter and power up.
+// settings made with the cgrf_set_* functions are kept.
 void cgrf_start_as_transmitter();
 
 // setup as a receiver and power up.
+// settings made with the cgrf_set_* functions are kept.
 void cgrf_start_as_reciever();
 
+// apply a complete radio profile, switch mode and power up.
+// the profile replaces earlier cgrf_set_* settings, except the channel and addresses.
+void cgrf_apply_profile(cgrf_profile_t const profile);
+
+// turn the radio round to listen or to send, without applying a profile.
+// a receiver sends to the address it listens on, and a transmitter listens on pipe 0, its own
+// address, so a payload sent by the receiver reaches every transmitter that is listening.
+void cgrf_turn_round(uint8_t const listen);
+
 // power up the transmitter/receiver and return the status
 uint8_t cgrf_power_up();
 
 // power down the transmitter/receiver and return the status
 uint8_t cgrf_power_down();
 
-// send data.
-acknowledgment_t cgrf_transmit_data(uint8_t const * const data, uint8_t const size);
+// send data, an unacknowledged payload is sent once without waiting for an acknowledgment.
+acknowledgment_t cgrf_transmit_data(uint8_t const * const data, uint8_t const size, delivery_t const delivery);
 acknowledgment_t cgrf_retransmit();
 
+// milliseconds before an asynchronous send without TX_DS or MAX_RT is abandoned.
+#define CGRF_SEND_TIMEOUT_MS 100
+
+// start sending a payload without waiting for the outcome.
+// returns a ticket, or 0 if the previous send is still in progress.
+// requires clock_init() for the timeout.
+uint8_t cgrf_send_async(uint8_t const * const data, uint8_t const size, delivery_t const delivery);
+
+// set the function called when a send completes, 0 for none.
+void cgrf_set_send_callback(cgrf_send_callback_t callback);
+
+// advance the send in progress and return the report for the most recent ticket.
+cgrf_send_report_t const * cgrf_poll();
+
+// start a transmit stream, CE is held high (Standby-II) until cgrf_stream_end().
+// every payload on the stream is sent with the given delivery class.
+// returns 0 unless the radio is a powered up transmitter.
+// the payloads in flight are counted as failed if none is sent for CGRF_SEND_TIMEOUT_MS, requires clock_init().
+uint8_t cgrf_stream_begin(delivery_t const delivery);
+
+// queue a payload on the stream, returns 0 if the TX FIFO is full.
+uint8_t cgrf_stream_push(uint8_t const * const data, uint8_t const size);
+
+// wait for the TX FIFO to empty, end the stream and return the payload counts.
+void cgrf_stream_end(cgrf_stream_t * result);
+
 uint8_t cgrf_data_ready();
 uint8_t cgrf_get_payload(uint8_t * data, uint8_t const size);
 
+// queue a payload to be sent back to the node on a data pipe with the next acknowledgment.
+// needs auto acknowledgment and dynamic payload length, returns 0 if every pool slot is in use.
+uint8_t cgrf_queue_ack_payload(uint8_t const pipe, uint8_t const * const data, uint8_t const size);
+
+// returns the number of payloads waiting to go back on a data pipe.
+uint8_t cgrf_ack_queued(uint8_t const pipe);
+
+// drop every queued acknowledgment payload.
+void cgrf_clear_ack_payloads();
+
+// set the function called on the transmitter for each payload that came back with an acknowledgment, 0 for none.
+void cgrf_set_ack_payload_callback(cgrf_rx_callback_t callback);
+
+// read every payload waiting in the receive FIFO, passing each to the callback.
+// returns the number of payloads read.
+uint8_t cgrf_drain_rx(cgrf_rx_callback_t callback);
+
+// move every payload waiting in the receive FIFO into the receive ring.
+// returns the number of frames stored, with NRF24_ASYNC_SPI it returns 0 at once
+// and the SPI interrupt stores the frames while the caller carries on.
+uint8_t cgrf_rx_ring_fill();
+
+#if defined(NRF24_IRQ_ENABLED) && defined(NRF24_ASYNC_SPI)
+
+// fill the receive ring from the radio interrupt instead of cgrf_rx_ring_fill().
+void cgrf_rx_ring_fill_from_irq(uint8_t const enable);
+
+#endif
+
+// returns the oldest frame in the receive ring, or 0 if the ring is empty.
+// the frame stays in its slot until cgrf_rx_release() is called.
+cgrf_frame_t const * cgrf_rx_peek();
+
+// release the oldest frame, freeing its slot.
+void cgrf_rx_release();
+
+// get the receive ring counters.
+void cgrf_rx_ring_stats(cgrf_ring_stats_t * stats);
+
+// reset the receive ring counters.
+void cgrf_rx_ring_reset_stats();
+
+// sample carrier detect (RPD) on every channel, adding the hits to the survey occupancy.
+// the radio must be powered up as a receiver, profile_channel_scan is intended for this.
+// writes up to count of the quietest channels, quietest first, and returns the number written.
+uint8_t cgrf_survey(cgrf_survey_t * survey, uint8_t const samples, uint8_t * quietest, uint8_t const count);
+
+// returns the occupancy count of a surveyed channel.
+uint8_t cgrf_survey_occupancy(cgrf_survey_t const * const survey, uint8_t const channel);
+
+// start hopping over a seeded pseudo-random order of the given channels, changing channel every interval.
+// both ends must use the same seed, channels and interval. the transmitter sets the slot timing,
+// the receiver waits on one channel until it hears the transmitter, then follows it.
+// requires clock_init(), returns 0 if the channels or interval are not valid.
+uint8_t cgrf_hop_begin(uint16_t const seed, uint8_t const * const channels, uint8_t const count, uint16_t const interval_ms);
+
+// stop hopping and stay on the current channel.
+void cgrf_hop_end();
+
+// follow the hopping sequence, call from the main loop.
+// returns 1 when a new slot has started, the transmitter should send early in the slot.
+uint8_t cgrf_hop_update();
+
+// returns 0 if the current channel is blacklisted and the transmitter should hold its sends.
+uint8_t cgrf_hop_clear_to_send();
+
+// get the frequency hopping state.
+void cgrf_hop_get_status(cgrf_hop_status_t * status);
+
 // check status for auto acknowledgment.
+// the outcome of a blocking send that was still retrying is counted in the link stats once it is seen.
 acknowledgment_t cgrf_check_acknowledgment();
 
 #endif /* CGRF_H_ */
\ No newline at end of file
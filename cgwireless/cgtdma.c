@@ -0,0 +1,326 @@
+/*
+ * cgtdma.c
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Time division multiple access, transmitters send in slots timed by the receiver's beacons.
+ */
+
+#include "cgtdma.h"
+#include "cgrf.h"
+#include "clock.h"
+#include <string.h>
+
+#define BEACON_MARKER		0x7E
+
+// a payload at 250 kbps is on the air for about 1.5 ms.
+#define PAYLOAD_MS			2
+
+typedef enum
+{
+	tdma_off,
+	tdma_coordinating,
+	tdma_searching,			// listening until a beacon is heard.
+	tdma_listening,			// listening for the beacon at the start of the frame.
+	tdma_sending,
+} tdma_state_t;
+
+static tdma_state_t m_state = tdma_off;
+static cgtdma_status_t m_status;
+static uint8_t m_slot = 0;
+static uint8_t m_slots = 0;
+static uint8_t m_slot_ms = 0;
+static uint16_t m_frame_ms = 0;
+static uint32_t m_frame_start = 0;		// network time of the start of the current frame.
+static uint8_t m_beacon_in_flight = 0;
+static uint8_t m_heard = 0;
+static uint8_t m_misses = 0;
+static uint32_t m_listened_frame = 0;	// start of the frame whose beacon was last listened for.
+
+// the network time is the local time at the last beacon, corrected for the rate of the local clock.
+static uint32_t m_sync_local = 0;
+static uint32_t m_sync_network = 0;
+
+// function declarations.
+uint16_t frame_position();
+void send_beacon();
+void tdma_beacon(uint8_t const pipe, uint8_t const * const data, uint8_t const size);
+void tdma_discipline(uint32_t const local, uint32_t const network);
+
+// start sending beacons from the receiver, the frame is slots transmitter slots after the beacon slot.
+// requires clock_init(), returns 0 if the layout is not valid.
+uint8_t cgtdma_coordinate(uint8_t const slots, uint8_t const slot_ms)
+{
+	if (slots == 0 || slots > CGTDMA_MAX_SLOTS || slot_ms < 2 * CGTDMA_GUARD_MS + PAYLOAD_MS)
+		return 0;
+
+	memset(&m_status, 0, sizeof(m_status));
+
+	m_slots = slots;
+	m_slot_ms = slot_ms;
+	m_frame_ms = (uint16_t)(slots + 1) * slot_ms;
+	m_beacon_in_flight = 0;
+
+	// the first beacon goes at the next update.
+	m_frame_start = clock_millis() - m_frame_ms;
+	m_status.synchronised = 1;
+	m_state = tdma_coordinating;
+
+	return 1;
+}
+
+// follow the beacons on a transmitter and send in the given slot, 1 to the number of slots.
+// the transmitter listens until it hears a beacon. requires clock_init(), returns 0 if the slot is not valid.
+uint8_t cgtdma_join(uint8_t const slot)
+{
+	if (slot == 0 || slot > CGTDMA_MAX_SLOTS)
+		return 0;
+
+	memset(&m_status, 0, sizeof(m_status));
+
+	m_slot = slot;
+	m_heard = 0;
+	m_misses = 0;
+	m_state = tdma_searching;
+	cgrf_turn_round(1);
+
+	return 1;
+}
+
+// stop sending or following beacons, and turn the radio back to its profile's direction.
+void cgtdma_end()
+{
+	if (m_state == tdma_off)
+		return;
+
+	cgrf_turn_round(m_state == tdma_coordinating);
+	m_state = tdma_off;
+	m_status.synchronised = 0;
+}
+
+// send or listen for the beacon, call at least every millisecond.
+void cgtdma_update()
+{
+	if (m_state == tdma_off)
+		return;
+
+	if (m_state == tdma_coordinating)
+	{
+		if (m_beacon_in_flight)
+		{
+			if (cgrf_poll()->result == send_in_progress)
+				return;
+
+			m_beacon_in_flight = 0;
+			cgrf_turn_round(1);
+		}
+
+		if (clock_millis() - m_frame_start >= m_frame_ms)
+			send_beacon();
+
+		return;
+	}
+
+	if (m_state != tdma_sending)
+	{
+		if (cgrf_data_ready())
+			cgrf_drain_rx(tdma_beacon);
+
+		if (m_heard)
+		{
+			m_heard = 0;
+			m_state = tdma_sending;
+			cgrf_turn_round(0);
+			return;
+		}
+	}
+
+	if (m_state == tdma_searching)
+		return;
+
+	uint16_t position = frame_position();
+
+	if (m_state == tdma_listening)
+	{
+		// the beacon slot has passed without one.
+		if (position >= m_slot_ms + CGTDMA_GUARD_MS && position < m_frame_ms - CGTDMA_GUARD_MS)
+		{
+			m_status.missed++;
+			m_misses++;
+			m_listened_frame = m_frame_start;
+
+			if (m_misses >= CGTDMA_MAX_MISSES)
+			{
+				m_status.synchronised = 0;
+				m_state = tdma_searching;
+				return;
+			}
+
+			m_state = tdma_sending;
+			cgrf_turn_round(0);
+		}
+
+		return;
+	}
+
+	// listen from just before the frame starts, once the send in progress has finished.
+	uint8_t window = position >= m_frame_ms - CGTDMA_GUARD_MS || (position < m_slot_ms && m_frame_start != m_listened_frame);
+
+	if (window && cgrf_poll()->result != send_in_progress)
+	{
+		m_state = tdma_listening;
+		cgrf_turn_round(1);
+	}
+}
+
+// returns the network time, the receiver's clock_millis().
+uint32_t cgtdma_time()
+{
+	uint32_t local = clock_millis();
+
+	if (m_state == tdma_coordinating || !m_status.synchronised)
+		return local;
+
+	uint32_t elapsed = local - m_sync_local;
+
+	// CGTDMA_MAX_MISSES frames are well inside 16 bits.
+	if (elapsed > 0xFFFF)
+		elapsed = 0xFFFF;
+
+	int32_t drift = ((int32_t)elapsed * m_status.skew) >> 16;
+
+	return m_sync_network + (local - m_sync_local) + drift;
+}
+
+// returns 1 on a transmitter while inside its slot, with room for a payload before the slot ends.
+uint8_t cgtdma_clear_to_send()
+{
+	if (m_state != tdma_sending || m_slot > m_slots)
+		return 0;
+
+	uint16_t position = frame_position();
+	uint16_t start = (uint16_t)m_slot * m_slot_ms;
+
+	return position >= start + CGTDMA_GUARD_MS && position + PAYLOAD_MS + CGTDMA_GUARD_MS <= start + m_slot_ms;
+}
+
+// get the TDMA state.
+void cgtdma_get_status(cgtdma_status_t * status)
+{
+	*status = m_status;
+}
+
+// private functions...
+//
+
+// milliseconds since the start of the current frame.
+uint16_t frame_position()
+{
+	int32_t position = (int32_t)(cgtdma_time() - m_frame_start);
+
+	// a beacon can set the frame start just ahead of the corrected time.
+	if (position < 0)
+		return 0;
+
+	while (position >= m_frame_ms)
+	{
+		m_frame_start += m_frame_ms;
+		position -= m_frame_ms;
+	}
+
+	return position;
+}
+
+// turn round and send the beacon for the frame starting now.
+void send_beacon()
+{
+	uint32_t now = clock_millis();
+
+	m_frame_start += m_frame_ms;
+
+	// more than a frame late, start again from now.
+	if (now - m_frame_start >= m_frame_ms)
+		m_frame_start = now;
+
+	uint8_t late = now - m_frame_start;
+
+	uint8_t beacon[CGTDMA_BEACON_SIZE];
+	beacon[0] = BEACON_MARKER;
+	beacon[1] = now & 0xFF;
+	beacon[2] = (now >> 8) & 0xFF;
+	beacon[3] = (now >> 16) & 0xFF;
+	beacon[4] = (now >> 24) & 0xFF;
+	beacon[5] = late;
+	beacon[6] = m_slot_ms;
+	beacon[7] = m_slots;
+
+	cgrf_turn_round(0);
+
+	if (cgrf_send_async(&beacon[0], CGTDMA_BEACON_SIZE, delivery_unacknowledged) == 0)
+	{
+		cgrf_turn_round(1);
+		return;
+	}
+
+	m_beacon_in_flight = 1;
+	m_status.beacons++;
+}
+
+// a payload heard while listening, the frame layout and time are taken from a beacon.
+void tdma_beacon(uint8_t const pipe, uint8_t const * const data, uint8_t const size)
+{
+	if (size != CGTDMA_BEACON_SIZE || data[0] != BEACON_MARKER || data[6] == 0 || data[7] == 0)
+		return;
+
+	uint32_t time = (uint32_t)data[1] | ((uint32_t)data[2] << 8) | ((uint32_t)data[3] << 16) | ((uint32_t)data[4] << 24);
+
+	tdma_discipline(clock_millis(), time + CGTDMA_LATENCY_MS);
+
+	m_slot_ms = data[6];
+	m_slots = data[7];
+	m_frame_ms = (uint16_t)(m_slots + 1) * m_slot_ms;
+	m_frame_start = time - data[5];
+	m_listened_frame = m_frame_start;
+	m_misses = 0;
+
+	m_status.beacons++;
+	m_status.synchronised = 1;
+	m_heard = 1;
+}
+
+// correct the rate and set the phase of the network time from a beacon.
+void tdma_discipline(uint32_t const local, uint32_t const network)
+{
+	int16_t error = 0;
+
+	if (m_status.synchronised)
+	{
+		int32_t difference = (int32_t)(network - cgtdma_time());
+		uint32_t elapsed = local - m_sync_local;
+
+		if (difference > 1000)
+			difference = 1000;
+		else if (difference < -1000)
+			difference = -1000;
+
+		error = difference;
+
+		// half the rate error measured over the interval, which smooths the millisecond jitter.
+		if (elapsed != 0 && elapsed <= 0xFFFF)
+		{
+			int32_t skew = m_status.skew + ((difference << 16) / (int32_t)elapsed) / 2;
+
+			if (skew > CGTDMA_MAX_SKEW)
+				skew = CGTDMA_MAX_SKEW;
+			else if (skew < -CGTDMA_MAX_SKEW)
+				skew = -CGTDMA_MAX_SKEW;
+
+			m_status.skew = skew;
+		}
+	}
+
+	m_status.last_error = error;
+	m_sync_local = local;
+	m_sync_network = network;
+}
@@ -0,0 +1,67 @@
+/*
+ * cgtdma.h
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Time division multiple access, transmitters send in slots timed by the receiver's beacons.
+ */
+
+#include <stdint.h>
+
+#ifndef CGTDMA_H_
+#define CGTDMA_H_
+
+// largest number of transmitter slots in a frame, slot 0 holds the beacon.
+#define CGTDMA_MAX_SLOTS 8
+
+// milliseconds kept clear at each edge of a slot for clock error and the radio turning round.
+#define CGTDMA_GUARD_MS 2
+
+// milliseconds from the beacon being loaded to it being read on a transmitter polled every millisecond.
+#define CGTDMA_LATENCY_MS 1
+
+// beacons missed in a row before a transmitter stops sending and searches again.
+#define CGTDMA_MAX_MISSES 4
+
+// largest clock rate correction, in 1/65536ths, about 10% for the internal RC oscillator.
+#define CGTDMA_MAX_SKEW 6554
+
+// the beacon payload, its marker, the network time, the lateness of the beacon in its slot,
+// the slot length and the number of transmitter slots.
+#define CGTDMA_BEACON_SIZE 8
+
+// TDMA state.
+typedef struct
+{
+	uint8_t synchronised;
+	uint16_t beacons;		// beacons sent by the receiver, or heard by a transmitter.
+	uint16_t missed;		// beacons a transmitter listened for and did not hear.
+	int16_t skew;			// clock rate correction, in 1/65536ths.
+	int16_t last_error;		// milliseconds between the predicted and the received network time.
+} cgtdma_status_t;
+
+// start sending beacons from the receiver, the frame is slots transmitter slots after the beacon slot.
+// requires clock_init(), returns 0 if the layout is not valid.
+uint8_t cgtdma_coordinate(uint8_t const slots, uint8_t const slot_ms);
+
+// follow the beacons on a transmitter and send in the given slot, 1 to the number of slots.
+// the transmitter listens until it hears a beacon. requires clock_init(), returns 0 if the slot is not valid.
+uint8_t cgtdma_join(uint8_t const slot);
+
+// stop sending or following beacons, and turn the radio back to its profile's direction.
+void cgtdma_end();
+
+// send or listen for the beacon, call at least every millisecond.
+void cgtdma_update();
+
+// returns the network time, the receiver's clock_millis().
+uint32_t cgtdma_time();
+
+// returns 1 on a transmitter while inside its slot, with room for a payload before the slot ends.
+uint8_t cgtdma_clear_to_send();
+
+// get the TDMA state.
+void cgtdma_get_status(cgtdma_status_t * status);
+
+#endif /* CGTDMA_H_ */
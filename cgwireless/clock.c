@@ -0,0 +1,77 @@
+/*
+ * clock.c
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Millisecond clock driven by the timer 2 compare match interrupt.
+ */ 
+
+#include "clock.h"
+
+#ifndef F_CPU				// if F_CPU was not defined in Project -> Properties
+#define F_CPU 1000000UL		// define it now as 1 MHz unsigned long
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+// timer 2 is clocked at 125 kHz, so 125 counts is 1 ms.
+#if F_CPU <= 2000000UL
+#define CLOCK_PRESCALER		8
+#define CLOCK_CS_BITS		(1 << CS21)
+#elif F_CPU <= 8000000UL
+#define CLOCK_PRESCALER		64
+#define CLOCK_CS_BITS		(1 << CS22)
+#else
+#define CLOCK_PRESCALER		128
+#define CLOCK_CS_BITS		((1 << CS22) | (1 << CS20))
+#endif
+
+#define CLOCK_COMPARE		(F_CPU / CLOCK_PRESCALER / 1000 - 1)
+
+static volatile uint32_t m_millis = 0;
+
+ISR(TIMER2_COMPA_vect)
+{
+	m_millis++;
+}
+
+// start the millisecond clock on timer 2.
+void clock_init()
+{
+	// clear timer on compare match (CTC) mode.
+	TCCR2A = (1 << WGM21);
+	TCCR2B = CLOCK_CS_BITS;
+	OCR2A = CLOCK_COMPARE;
+	TCNT2 = 0;
+
+	TIMSK2 |= (1 << OCIE2A);
+}
+
+// milliseconds since clock_init().
+uint32_t clock_millis()
+{
+	// the 32 bit count must not change part way through reading it.
+	uint8_t sreg = SREG;
+	cli();
+	uint32_t millis = m_millis;
+	SREG = sreg;
+
+	return millis;
+}
+
+// milliseconds elapsed since the given clock_millis() value.
+uint32_t clock_elapsed(uint32_t const since)
+{
+	return clock_millis() - since;
+}
+
+// add the milliseconds spent in a sleep mode that stops timer 2.
+void clock_advance(uint16_t const ms)
+{
+	uint8_t sreg = SREG;
+	cli();
+	m_millis += ms;
+	SREG = sreg;
+}
@@ -0,0 +1,27 @@
+/*
+ * clock.h
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Millisecond clock driven by the timer 2 compare match interrupt.
+ */ 
+
+#include <stdint.h>
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+// start the millisecond clock on timer 2.
+void clock_init();
+
+// milliseconds since clock_init().
+uint32_t clock_millis();
+
+// milliseconds elapsed since the given clock_millis() value.
+uint32_t clock_elapsed(uint32_t const since);
+
+// add the milliseconds spent in a sleep mode that stops timer 2.
+void clock_advance(uint16_t const ms);
+
+#endif /* CLOCK_H_ */
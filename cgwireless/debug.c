@@ -12,6 +12,7 @@
 #include "debug.h"
 #include "display.h"
 #include "nrf24l01.h"
+#include "cgrf.h"
 #include "cgoled.h"
 #include <util/delay.h>
 
@@ -132,3 +133,41 @@ void display_registers()
 	_delay_ms(1000);
 }
 
+// show a 16 bit counter in hex under its label.
+void display_counter(char * const text, uint8_t const size, uint16_t const value)
+{
+	display_string(text, size, 1, 1);
+	display_hex(value >> 8, 1, 2);
+	display_hex(value & 0xFF, 3, 2);
+	_delay_ms(1000);
+}
+
+// step through a snapshot of the link counters, the retransmit bins that are empty are skipped.
+void display_link_stats()
+{
+	cgrf_stats_t stats;
+	cgrf_get_stats(&stats);
+
+	display_counter("SENT      ", 10, stats.sent);
+	display_counter("ACKED     ", 10, stats.acknowledged);
+	display_counter("NO ACK    ", 10, stats.unacknowledged);
+	display_counter("MAX RT    ", 10, stats.max_retries);
+	display_counter("TIMEOUTS  ", 10, stats.timeouts);
+	display_counter("RECEIVED  ", 10, stats.received);
+	display_counter("RX PER SEC", 10, stats.rx_per_second);
+	display_counter("RX FULL   ", 10, stats.rx_fifo_full);
+	display_counter("CORRUPT   ", 10, stats.corrupt);
+	display_counter("DROPPED   ", 10, stats.dropped);
+
+	char text[10] = { 'A', 'R', 'C', ' ', ' ', ' ', ' ', ' ', ' ', ' ' };
+
+	for (uint8_t arc = 0; arc != CGRF_RETRANSMIT_BINS; arc++)
+	{
+		if (stats.retransmits[arc] == 0)
+			continue;
+
+		text[4] = '0' + arc / 10;
+		text[5] = '0' + arc % 10;
+		display_counter(&text[0], 10, stats.retransmits[arc]);
+	}
+}
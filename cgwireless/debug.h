@@ -16,5 +16,7 @@ void display_buffer_hex(uint8_t const * const buffer);
 void display_register(char * const text, uint8_t const size, uint8_t value);
 void display_address(uint8_t const * const addr);
 void display_registers();
+void display_counter(char * const text, uint8_t const size, uint16_t const value);
+void display_link_stats();
 
 #endif /* DEBUG_H_ */
\ No newline at end of file
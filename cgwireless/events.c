@@ -0,0 +1,91 @@
+/*
+ * events.c
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Cooperative event loop, handlers run to completion in priority order.
+ */
+
+#include "events.h"
+#include "scheduler.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+// one bit for each event, bit 0 is the highest priority.
+static volatile uint8_t m_pending = 0;
+static event_handler_t m_handlers[EVENTS_COUNT];
+
+// clear every handler and pending event, and keep the scheduler awake while events are pending.
+void events_init()
+{
+	for (uint8_t i = 0; i < EVENTS_COUNT; i++)
+		m_handlers[i] = 0;
+
+	m_pending = 0;
+	scheduler_set_wake_check(events_pending);
+}
+
+// set the function that handles an event, 0 for none.
+void events_set_handler(event_t const event, event_handler_t handler)
+{
+	if (event < EVENTS_COUNT)
+		m_handlers[event] = handler;
+}
+
+// post an event, safe to call from an interrupt.
+// an event posted again before it is handled is handled once.
+void events_post(event_t const event)
+{
+	uint8_t sreg = SREG;
+	cli();
+	m_pending |= (1 << event);
+	SREG = sreg;
+}
+
+// returns 1 if any event is waiting to be handled.
+uint8_t events_pending()
+{
+	return m_pending != 0;
+}
+
+// handle the highest priority event waiting, returns 0 if there was none.
+uint8_t events_dispatch()
+{
+	uint8_t sreg = SREG;
+	cli();
+
+	uint8_t pending = m_pending;
+	uint8_t event = 0;
+
+	if (pending == 0)
+	{
+		SREG = sreg;
+		return 0;
+	}
+
+	while (!(pending & (1 << event)))
+		event++;
+
+	// cleared before the handler runs, so a post during it is not lost.
+	m_pending = pending & ~(1 << event);
+	SREG = sreg;
+
+	if (m_handlers[event] != 0)
+		m_handlers[event]();
+
+	return 1;
+}
+
+// handle events in priority order and run the scheduler's tasks, sleeping when there is
+// nothing to do. does not return.
+void events_run()
+{
+	while (1)
+	{
+		// one event at a time, so radio events posted meanwhile go ahead of the rest.
+		if (!events_dispatch())
+			scheduler_run();
+	}
+}
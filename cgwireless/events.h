@@ -0,0 +1,51 @@
+/*
+ * events.h
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Cooperative event loop, handlers run to completion in priority order.
+ */
+
+#include <stdint.h>
+
+#ifndef EVENTS_H_
+#define EVENTS_H_
+
+// events in priority order, radio work is always handled before the display.
+typedef enum
+{
+	event_radio_rx,
+	event_radio_tx,
+	event_adc_ready,
+	event_button,
+	event_timer,
+	event_display,
+} event_t;
+
+#define EVENTS_COUNT 6
+
+// runs to completion, it should not wait on the radio or the display.
+typedef void (*event_handler_t)();
+
+// clear every handler and pending event, and keep the scheduler awake while events are pending.
+void events_init();
+
+// set the function that handles an event, 0 for none.
+void events_set_handler(event_t const event, event_handler_t handler);
+
+// post an event, safe to call from an interrupt.
+// an event posted again before it is handled is handled once.
+void events_post(event_t const event);
+
+// returns 1 if any event is waiting to be handled.
+uint8_t events_pending();
+
+// handle the highest priority event waiting, returns 0 if there was none.
+uint8_t events_dispatch();
+
+// handle events in priority order and run the scheduler's tasks, sleeping when there is
+// nothing to do. does not return.
+void events_run();
+
+#endif /* EVENTS_H_ */
@@ -22,6 +22,31 @@
 #define ADC_PRESCALER_64	0x06
 #define ADC_PRESCALER_128	0x07
 
+// light sensor samples per second, sent 30 to a packet.
+#define SAMPLE_RATE_HZ		200
+
+// uncomment for the receiver to send TDMA beacons and the transmitter to send only in its slot.
+// the receiver then sends a beacon every frame, and while sampling the transmitter wakes every
+// tick to follow them instead of every 10 ms.
+//#define TDMA_ENABLED
+
+// a 50 ms TDMA frame, the beacon slot and four 10 ms transmitter slots, this transmitter has slot 1.
+#define TDMA_SLOTS			4
+#define TDMA_SLOT_MS		10
+#define TDMA_SLOT			1
+
+// the transmitter polls the send in flight, a packet fills every 150 ms.
+// with TDMA it also follows the beacons, every tick.
+#ifdef TDMA_ENABLED
+#define SEND_PERIOD_MS		1
+#else
+#define SEND_PERIOD_MS		10
+#endif
+
+// the receiver polls the radio every tick and updates the display four times a second.
+#define RECEIVE_POLL_MS		1
+#define DISPLAY_PERIOD_MS	250
+
 #include <avr/io.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -32,21 +57,42 @@
 #include "cgrf.h"
 #include "display.h"
 #include "debug.h"
+#include "clock.h"
+#include "adc.h"
+#include "scheduler.h"
+#include "events.h"
+#include "cgtdma.h"
+#include "profile.h"
 
 void setup_btn_interrupts();
 void setup_led(void);
 void setup_light_sensor();
 void led_on(void);
 void led_off(void);
-void single_adc_conversion();
 
 void config_transmit();
 void run_transmit();
+void transmit_button();
+void transmit_poll();
+void transmit_packet();
+void transmit_sent(cgrf_send_report_t const * const report);
 void config_receive();
 void run_receive();
+void receive_button();
+void receive_poll();
+void receive_frames();
+void receive_display();
+void post_timer();
+void post_display();
+void post_adc_ready();
 uint8_t find_channel();
+void store_payload(uint8_t const pipe, uint8_t const * const data, uint8_t const size);
 
 volatile uint8_t m_button_on = 0;
+uint8_t m_received_value = 0;
+uint8_t m_value_changed = 0;
+uint8_t m_transmitting = 0;
+uint8_t m_receiving = 0;
 
 // routine for PCMSK1 interrupt.
 ISR(PCINT1_vect)
@@ -58,6 +104,8 @@ ISR(PCINT1_vect)
 			m_button_on = 1;
 		else
 			m_button_on = 0;
+
+		events_post(event_button);
 	}
 }
 
@@ -122,15 +170,6 @@ void setup_light_sensor()
 	ADCSRA |= (1 << 7) | ADC_PRESCALER_8;
 }
 
-void single_adc_conversion()
-{
-	// Start an ADC conversion by setting ADSC bit (bit 6)
-	ADCSRA |= (1 << ADSC);
-	
-	// Wait until the ADSC bit has been cleared
-	while(ADCSRA & (1 << ADSC));
-}
-
 int main(void)
 {
 	//config_transmit();
@@ -147,50 +186,115 @@ void config_transmit()
 	setup_led();
 	setup_light_sensor();
 
+	clock_init();
 	cgrf_init();
 	cgrf_start_as_transmitter();
 	cgrf_power_down();
-	_delay_ms(5);
+
+#ifdef PROFILE_ENABLED
+	profile_init();
+#endif
+	scheduler_sleep_ms(5);
 }
 
 void run_transmit()
 {
-	uint8_t buffer[32] = {1, 2, 3};
-	uint8_t running = 0;
-	
-	while (1)
+	events_init();
+	events_set_handler(event_button, transmit_button);
+	events_set_handler(event_timer, transmit_poll);
+	events_set_handler(event_adc_ready, transmit_packet);
+	events_set_handler(event_radio_tx, transmit_packet);
+
+	adc_set_ready_callback(post_adc_ready);
+	cgrf_set_send_callback(transmit_sent);
+
+	// stopped, only the watchdog and the button wake the MCU.
+	scheduler_allow_power_save(1);
+
+	events_run();
+}
+
+// start or stop sampling when the button has been pressed.
+void transmit_button()
+{
+	if (m_transmitting == m_button_on)
+		return;
+
+	m_transmitting = m_button_on;
+
+	if (m_transmitting)
 	{
-		if (running != m_button_on)
-		{
-			if (running == 0)
-				running = 1;
-			else
-				running = 0;
-
-			if (running == 1)
-			{
-				cgrf_power_up();
-				led_on();
-			}
-			else
-			{
-				cgrf_power_down();
-				led_off();
-			}
-		}
-		
-		if (running)
-		{
-			single_adc_conversion();
-			buffer[0] = ADCH;
-			buffer[1] = buffer[1] + 1;
-			buffer[2] = 0;
-
-			cgrf_transmit_data(&buffer[0], 3);
-		}
-
-		_delay_ms(50);
-	}	
+		cgrf_power_up();
+		led_on();
+
+		// the light sensor is on ADC3.
+		adc_start(3, SAMPLE_RATE_HZ, ADC_MAX_SAMPLES);
+
+#ifdef TDMA_ENABLED
+		cgtdma_join(TDMA_SLOT);
+#endif
+		scheduler_add(post_timer, SEND_PERIOD_MS);
+	}
+	else
+	{
+		scheduler_remove(post_timer);
+
+#ifdef TDMA_ENABLED
+		cgtdma_end();
+#endif
+		adc_stop();
+		cgrf_power_down();
+		led_off();
+
+#ifdef PROFILE_ENABLED
+		// adc_stop() stopped timer 1.
+		profile_init();
+#endif
+	}
+
+	// the ADC is triggered by timer 1, which stops in the power save mode.
+	scheduler_allow_power_save(!m_transmitting);
+}
+
+// advance the send in flight, its completion posts event_radio_tx.
+void transmit_poll()
+{
+	if (!m_transmitting)
+		return;
+
+	cgrf_poll();
+
+#ifdef TDMA_ENABLED
+	cgtdma_update();
+
+	// a packet held back until the slot came round.
+	transmit_packet();
+#endif
+}
+
+// send the packet of samples waiting, if the radio is free and the slot has come round.
+void transmit_packet()
+{
+	if (!m_transmitting)
+		return;
+
+#ifdef TDMA_ENABLED
+	if (!cgtdma_clear_to_send())
+		return;
+#endif
+
+	uint8_t size = 0;
+	uint8_t const * packet = adc_packet(&size);
+
+	// a lost packet of samples does not matter, skip the acknowledgment turnaround.
+	if (packet != 0 && cgrf_send_async(packet, size, delivery_unacknowledged) != 0)
+		adc_release();
+}
+
+// called from cgrf_poll() when a send completes.
+void transmit_sent(cgrf_send_report_t const * const report)
+{
+	events_post(event_radio_tx);
 }
 
 void config_receive()
@@ -200,102 +304,165 @@ void config_receive()
 	config_character_display();
 	oled_power_on();
 
+	clock_init();
 	cgrf_init();
 	cgrf_start_as_reciever();
+
+#if defined(NRF24_IRQ_ENABLED) && defined(NRF24_ASYNC_SPI)
+	cgrf_rx_ring_fill_from_irq(1);
+#endif
+
+#ifdef PROFILE_ENABLED
+	profile_init();
+#endif
+
 	led_on();
-	_delay_ms(5);
+	scheduler_sleep_ms(5);
 }
 
 void run_receive()
 {
-	uint8_t buffer[32] = {0, 0, 0};
-	uint8_t running = 1;
-
 	display_string("Listen",6,1,1);
 	display_channel();
 	m_button_on = 1;
-	uint8_t div = 0;
+	m_receiving = 1;
+
+	events_init();
+	events_set_handler(event_radio_rx, receive_frames);
+	events_set_handler(event_button, receive_button);
+	events_set_handler(event_timer, receive_poll);
+	events_set_handler(event_display, receive_display);
+
+#ifdef TDMA_ENABLED
+	// beacons time the transmitters' slots.
+	cgtdma_coordinate(TDMA_SLOTS, TDMA_SLOT_MS);
+#endif
+
+	scheduler_add(post_timer, RECEIVE_POLL_MS);
+	scheduler_add(post_display, DISPLAY_PERIOD_MS);
+
+	events_run();
+}
 
-	while (1)
+// power the radio and the display up or down when the button has been pressed.
+void receive_button()
+{
+	if (m_receiving == m_button_on)
+		return;
+
+	m_receiving = m_button_on;
+
+	if (m_receiving)
 	{
-		if (running != m_button_on)
-		{
-			if (running == 0)
-				running = 1;
-			else
-				running = 0;
-
-			if (running == 1)
-			{
-				cgrf_power_up();
-				led_on();
-				oled_power_on();	
-			}
-			else
-			{
-				cgrf_power_down();
-				led_off();
-				oled_power_off();
-			}
-		}
-		
-		if (running == 1)
-		{
-			if (cgrf_data_ready() == 1)
-			{		
-				cgrf_get_payload(&buffer[0], 3);	
-				div += 1;
-			}
-			
-			// slow the display down.
-			if (div == 4)
-			{
-				div = 0;
-				display_number(buffer[0], 1, 2);
-			}
-		}
+		cgrf_power_up();
+		led_on();
+		oled_power_on();
+	}
+	else
+	{
+		cgrf_power_down();
+		led_off();
+		oled_power_off();
 	}
 }
 
+// send the beacon when it is due, with TDMA, and check the radio for frames.
+void receive_poll()
+{
+	if (!m_receiving)
+		return;
+
+#ifdef TDMA_ENABLED
+	cgtdma_update();
+#endif
 
-uint8_t find_channel()
+	if (cgrf_rx_peek() != 0 || cgrf_data_ready() == 1)
+		events_post(event_radio_rx);
+}
+
+// store the frames waiting, a ring's worth at a time so the handler's cost is bounded.
+void receive_frames()
 {
-	uint8_t carrier = 0;
-	uint8_t ch = 0;
-	display_string("          ", 10,1,1);
-	cgrf_set_crc_encoding(crc_none);
-	
-	while (1)
+	if (!m_receiving)
+		return;
+
+	if (cgrf_data_ready() == 1)
+		cgrf_rx_ring_fill();
+
+	cgrf_frame_t const * frame = cgrf_rx_peek();
+
+	for (uint8_t i = 0; i < CGRF_RX_RING_SIZE && frame != 0; i++)
+	{
+		store_payload(frame->pipe, &frame->data[0], frame->size);
+		cgrf_rx_release();
+
+		frame = cgrf_rx_peek();
+	}
+
+	// more frames arrived while the ring was emptied.
+	if (frame != 0)
+		events_post(event_radio_rx);
+}
+
+// show the most recent value, only when it has changed.
+void receive_display()
+{
+	if (!m_receiving || !m_value_changed)
+		return;
+
+	m_value_changed = 0;
+	display_number(m_received_value, 1, 2);
+}
+
+// scheduler tasks, and the ADC callback, posting events.
+void post_timer()
+{
+	events_post(event_timer);
+}
+
+void post_display()
+{
+	events_post(event_display);
+}
+
+void post_adc_ready()
+{
+	events_post(event_adc_ready);
+}
+
+// store the most recent sample of each received packet.
+void store_payload(uint8_t const pipe, uint8_t const * const data, uint8_t const size)
+{
+	if (size > ADC_HEADER_SIZE)
 	{
-		for (ch = 0; ch != 128; ch++)
-		{
-			cgrf_set_channel(ch);
-			display_number(ch, 1, 1);
-				
-			for (uint8_t n = 0; n != 100; n++)
-			{
-				uint8_t status = nrf24_get_cd(&carrier);
-				display_hex(status, 5, 1);
-				
-				if (carrier != 0)
-					break;
-
-				_delay_us(10);
-			}
-		
-			if (carrier != 0)
-				break;
-		}
-		
-		if (carrier != 0)
-			break;
+		m_received_value = data[size - 1];
+		m_value_changed = 1;
 	}
+}
+
+
+// survey the band and move the receiver to the quietest channel.
+// returns the channel.
+uint8_t find_channel()
+{
+	cgrf_survey_t survey = { { 0 } };
+	uint8_t quietest = 0;
+
+	display_string("          ", 10,1,1);
+	cgrf_apply_profile(profile_channel_scan);
+
+	// the display is only updated once the survey is complete.
+	for (uint8_t sweep = 0; sweep != 3; sweep++)
+		cgrf_survey(&survey, 4, 0, 0);
+
+	cgrf_survey(&survey, 4, &quietest, 1);
 
-	cgrf_set_crc_encoding(crc_1_byte);
+	cgrf_set_channel(quietest);
+	cgrf_apply_profile(profile_receiver);
 	
-	display_string("found", 1, 1, 1);
+	display_string("quiet", 1, 1, 1);
 	display_channel();
-	display_binary(carrier, 1, 2);
+	display_number(cgrf_survey_occupancy(&survey, quietest), 1, 2);
 	
-	return carrier;
+	return quietest;
 }
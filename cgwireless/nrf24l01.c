@@ -6,6 +6,7 @@
  */ 
 
 #include "nrf24l01.h"
+#include "profile.h"
 
 #ifndef F_CPU				// if F_CPU was not defined in Project -> Properties
 #define F_CPU 1000000UL		// define it now as 8 MHz unsigned long
@@ -13,6 +14,12 @@
 
 #include <util/delay.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <string.h>
+
+#if defined(NRF24_ASYNC_SPI) && !defined(NRF24_HARDWARE_SPI)
+#error "NRF24_ASYNC_SPI requires NRF24_HARDWARE_SPI"
+#endif
 
 #define NRF24_PORT_SCK PORTB
 #define NRF24_DDR_SCK DDRB
@@ -27,67 +34,57 @@
 #define NRF24_DDR_MOSI DDRB
 #define NRF24_MOSI PB3
 
+#define NRF24_PORT_SS PORTB
+#define NRF24_DDR_SS DDRB
+#define NRF24_SS PB2
+
+
+// STATUS interrupt bits.
+#define STATUS_RX_DR  0x40
+#define STATUS_TX_DS  0x20
+#define STATUS_MAX_RT 0x10
+#define STATUS_IRQ    (STATUS_RX_DR | STATUS_TX_DS | STATUS_MAX_RT)
+
+#if defined(NRF24_IRQ_INT0)
+#undef NRF24_PORT_IRQ
+#undef NRF24_DDR_IRQ
+#undef NRF24_PIN_IRQ
+#undef NRF24_IRQ
+#undef NRF24_IRQ_vect
+#define NRF24_PORT_IRQ PORTD
+#define NRF24_DDR_IRQ DDRD
+#define NRF24_PIN_IRQ PIND
+#define NRF24_IRQ PD2
+#define NRF24_IRQ_vect INT0_vect
+#endif
 
-// Register map table addresses
-// ----------------------------
-// configuration register address.
-// enhanced ShockBurst address.
-// enabled RX addresses.
-// setup of address widths.
-// setup of automatic retransmission
-// RF channel
-// RF setup register
-// status register
-//   (In parallel to the SPI command word applied on the MOSI pin,
-//   the status register is shifted serially out on the MISO pin)
-// transmit observe register
-
-// Register map table
-#define RMAP_CONFIG		 0x00
-#define RMAP_EN_AA       0x01
-#define RMAP_EN_RXADDR   0x02
-#define RMAP_SETUP_AW    0x03
-#define RMAP_SETUP_RETR  0x04
-#define RMAP_RF_CH       0x05
-#define RMAP_RF_SETUP    0x06
-#define RMAP_STATUS		 0x07
-#define RMAP_OBSERVE_TX  0x08
-#define RMAP_CD          0x09
-#define RMAP_RX_ADDR_P0  0x0A
-#define RMAP_RX_ADDR_P1  0x0B
-#define RMAP_RX_ADDR_P2  0x0C
-#define RMAP_RX_ADDR_P3  0x0D
-#define RMAP_RX_ADDR_P4  0x0E
-#define RMAP_RX_ADDR_P5  0x0F
-#define RMAP_TX_ADDR     0x10
-#define RMAP_RX_PW_P0    0x11
-#define RMAP_RX_PW_P1    0x12
-#define RMAP_RX_PW_P2    0x13
-#define RMAP_RX_PW_P3    0x14
-#define RMAP_RX_PW_P4    0x15
-#define RMAP_RX_PW_P5    0x16
-#define RMAP_FIFO_STATUS 0x17
-#define RMAP_DYNPD       0x1C
-#define RMAP_FEATURE     0x1D
-
-/* Instruction Mnemonics */
-#define R_REGISTER    0x00
-#define W_REGISTER    0x20
-#define REGISTER_MASK 0x1F
-#define ACTIVATE      0x50
-#define R_RX_PL_WID   0x60
-#define R_RX_PAYLOAD  0x61
-#define W_TX_PAYLOAD  0xA0
-#define W_ACK_PAYLOAD 0xA8
-#define FLUSH_TX      0xE1
-#define FLUSH_RX      0xE2
-#define REUSE_TX_PL   0xE3
-#define RF24_NOP      0xFF
+// Register shadow
+// ---------------
+// write-through copy of the configuration registers, CONFIG to FEATURE and the
+// addresses, so reading them back does not need an SPI transaction.
+// STATUS, OBSERVE_TX, CD and FIFO_STATUS change on the chip and are always read live.
+static uint8_t m_registers[RMAP_FEATURE + 1];
+static uint8_t m_rx_address_p0[5];
+static uint8_t m_rx_address_p1[5];
+static uint8_t m_tx_address[5];
+static uint8_t m_shadow_valid = 0;
+
+// status byte from the most recent transaction.
+static uint8_t m_status = 0;
+
+#if defined(NRF24_IRQ_ENABLED) && defined(NRF24_ASYNC_SPI)
+// STATUS interrupt bits latched and cleared by the IRQ routine.
+static volatile uint8_t m_irq_flags = 0;
+#endif
 
 // function declarations
+uint8_t transaction(uint8_t const cmd, uint8_t const * const tx, uint8_t * rx, uint8_t const size);
 uint8_t write_register_value(uint8_t const reg_map_addr, uint8_t const data);
 uint8_t write_register_bytes(uint8_t const reg_map_addr, uint8_t const * const data, uint8_t const size);
 uint8_t read_register_bytes(uint8_t const reg_map_addr, uint8_t * dataptr, uint8_t const size);
+uint8_t read_register_live(uint8_t const reg_map_addr, uint8_t * dataptr, uint8_t const size);
+uint8_t * register_shadow(uint8_t const reg_map_addr);
+uint8_t transmit_payload(uint8_t const cmd, nrf24_mode_t const mode, uint8_t const * const data, uint8_t const size);
 
 // SPI function declaration.
 uint8_t spi_out_command(uint8_t const cmd);
@@ -108,41 +105,53 @@ void nrf24_configure_ports()
 	// Set port pins as input.
 	NRF24_DDR_MISO &= ~(1 << NRF24_MISO);
 
+#ifdef NRF24_HARDWARE_SPI
+	// SS must be an output, otherwise a low level on the pin
+	// switches the SPI peripheral out of master mode.
+	NRF24_DDR_SS |= (1 << NRF24_SS);
+
+	// enable SPI as master, MSB first, mode 0 (CPOL = 0, CPHA = 0).
+	// SPI2X doubles the F_CPU/4 rate to F_CPU/2.
+	SPCR = (1 << SPE) | (1 << MSTR);
+	SPSR = (1 << SPI2X);
+#endif
+
+#ifdef NRF24_ASYNC_SPI
+	// interrupt on completion of each byte.
+	SPCR |= (1 << SPIE);
+#endif
+
 	// Set CE low.
 	NRF24_PORT_CE &= ~(1 << NRF24_CE);
 
 	// Ensure CSN is high.
 	NRF24_PORT_CSN |= (1 << NRF24_CSN);
+
+#ifdef NRF24_IRQ_ENABLED
+	// IRQ pin as input.
+	NRF24_DDR_IRQ &= ~(1 << NRF24_IRQ);
+#endif
+
+#if defined(NRF24_IRQ_INT0)
+	// interrupt on the falling edge of INT0.
+	EICRA = (EICRA & ~((1 << ISC01) | (1 << ISC00))) | (1 << ISC01);
+	EIMSK |= (1 << INT0);
+#elif defined(NRF24_IRQ_PCINT)
+	NRF24_IRQ_PCMSK |= (1 << NRF24_IRQ);
+	PCICR |= (1 << NRF24_IRQ_PCIE);
+#endif
 }
 
 // flush to transmitter buffer.
 uint8_t nrf24_flush_tx()
 {
-	// every command must be started by a high to low transition on CSN.
-	// set CSN low to begin command.
-	NRF24_PORT_CSN &= ~(1 << NRF24_CSN);
-
-	uint8_t status = spi_out_command(FLUSH_TX);
-	
-	// Set CSN high to end command.
-	NRF24_PORT_CSN |= (1 << NRF24_CSN);
-	
-	return status;
+	return transaction(FLUSH_TX, 0, 0, 0);
 }
 
 // flush the receiver buffer.
 uint8_t nrf24_flush_rx()
 {
-	// every command must be started by a high to low transition on CSN.
-	// set CSN low to begin command.
-	NRF24_PORT_CSN &= ~(1 << NRF24_CSN);
-
-	uint8_t status = spi_out_command(FLUSH_RX);
-	
-	// Set CSN high to end command.
-	NRF24_PORT_CSN |= (1 << NRF24_CSN);
-	
-	return status;
+	return transaction(FLUSH_RX, 0, 0, 0);
 }
 
 // get the config register value and return by pointer;
@@ -232,12 +241,23 @@ uint8_t nrf24_set_rf_setup(uint8_t const value)
 // get status register value and return by pointer;
 uint8_t nrf24_get_status(uint8_t * value)
 {
-	return read_register_bytes(RMAP_STATUS, value, 1);
+	uint8_t status = read_register_bytes(RMAP_STATUS, value, 1);
+
+#if defined(NRF24_IRQ_ENABLED) && defined(NRF24_ASYNC_SPI)
+	// include the bits the IRQ routine has already cleared from the chip.
+	*value |= m_irq_flags;
+#endif
+
+	return status;
 }
 
 // set status register.
 uint8_t nrf24_set_status(uint8_t const value)
 {
+#if defined(NRF24_IRQ_ENABLED) && defined(NRF24_ASYNC_SPI)
+	m_irq_flags &= ~(value & STATUS_IRQ);
+#endif
+
 	return write_register_value(RMAP_STATUS, value);
 }
 
@@ -397,28 +417,133 @@ uint8_t nrf24_set_rx_address_pipe1(uint8_t addr[5])
 	return write_register_bytes(RMAP_RX_ADDR_P1, addr, 5);
 }
 
+// get the rx address data pipe 2, least significant byte.
+uint8_t nrf24_get_rx_address_pipe2(uint8_t * value)
+{
+	return read_register_bytes(RMAP_RX_ADDR_P2, value, 1);
+}
+
+// set the rx address data pipe 2, least significant byte.
+uint8_t nrf24_set_rx_address_pipe2(uint8_t const value)
+{
+	return write_register_value(RMAP_RX_ADDR_P2, value);
+}
+
+// get the rx address data pipe 3, least significant byte.
+uint8_t nrf24_get_rx_address_pipe3(uint8_t * value)
+{
+	return read_register_bytes(RMAP_RX_ADDR_P3, value, 1);
+}
+
+// set the rx address data pipe 3, least significant byte.
+uint8_t nrf24_set_rx_address_pipe3(uint8_t const value)
+{
+	return write_register_value(RMAP_RX_ADDR_P3, value);
+}
+
+// get the rx address data pipe 4, least significant byte.
+uint8_t nrf24_get_rx_address_pipe4(uint8_t * value)
+{
+	return read_register_bytes(RMAP_RX_ADDR_P4, value, 1);
+}
+
+// set the rx address data pipe 4, least significant byte.
+uint8_t nrf24_set_rx_address_pipe4(uint8_t const value)
+{
+	return write_register_value(RMAP_RX_ADDR_P4, value);
+}
+
+// get the rx address data pipe 5, least significant byte.
+uint8_t nrf24_get_rx_address_pipe5(uint8_t * value)
+{
+	return read_register_bytes(RMAP_RX_ADDR_P5, value, 1);
+}
+
+// set the rx address data pipe 5, least significant byte.
+uint8_t nrf24_set_rx_address_pipe5(uint8_t const value)
+{
+	return write_register_value(RMAP_RX_ADDR_P5, value);
+}
+
+// get any single byte register value by register map address and return by pointer;
+uint8_t nrf24_get_register(uint8_t const reg_map_addr, uint8_t * value)
+{
+	return read_register_bytes(reg_map_addr, value, 1);
+}
+
 // get the carrier detect.
 uint8_t nrf24_get_cd(uint8_t * value)
 {
 	return read_register_bytes(RMAP_CD, value, 1);
 }
 
+// write a register only when the value differs from the shadow copy.
+// returns 1 if the register was written.
+uint8_t nrf24_update_register(uint8_t const reg_map_addr, uint8_t const value)
+{
+	return nrf24_update_register_bytes(reg_map_addr, &value, 1);
+}
+
+// write a multi-byte register only when the value differs from the shadow copy.
+// returns 1 if the register was written.
+uint8_t nrf24_update_register_bytes(uint8_t const reg_map_addr, uint8_t const * const data, uint8_t const size)
+{
+	uint8_t * shadow = register_shadow(reg_map_addr);
+
+	if (m_shadow_valid && shadow != 0 && memcmp(shadow, data, size) == 0)
+		return 0;
+
+	write_register_bytes(reg_map_addr, data, size);
+	return 1;
+}
+
+// reload the register shadow from the chip.
+// call once the chip is powered, and again after a brown-out or reset of the chip.
+// R_REGISTER does not step on to the next register, so each one takes its own transaction,
+// the multi-byte transfers are only the 5 byte addresses.
+uint8_t nrf24_resync_registers()
+{
+	uint8_t status = 0;
+
+	for (uint8_t reg = RMAP_CONFIG; reg <= RMAP_FEATURE; reg++)
+	{
+		uint8_t * shadow = register_shadow(reg);
+
+		// skip the live registers and the unused addresses 0x18 to 0x1B.
+		if (shadow == 0 || (reg > RMAP_FIFO_STATUS && reg < RMAP_DYNPD))
+			continue;
+
+		if (reg == RMAP_RX_ADDR_P0 || reg == RMAP_RX_ADDR_P1 || reg == RMAP_TX_ADDR)
+			status = read_register_live(reg, shadow, 5);
+		else
+			status = read_register_live(reg, shadow, 1);
+	}
+
+	m_shadow_valid = 1;
+	return status;
+}
+
 
 // send data.
 uint8_t nrf24_transmit_data(nrf24_mode_t const mode, uint8_t const * const data, uint8_t const size)
 {
-	// every command must be started by a high to low transition on CSN.
-	// set CSN low to begin command.
-	NRF24_PORT_CSN &= ~(1 << NRF24_CSN);
+	return transmit_payload(W_TX_PAYLOAD, mode, data, size);
+}
 
+// send data without asking for an auto acknowledgment, needs EN_DYN_ACK in the feature register.
+uint8_t nrf24_transmit_data_no_ack(nrf24_mode_t const mode, uint8_t const * const data, uint8_t const size)
+{
+	return transmit_payload(W_TX_PAYLOAD_NOACK, mode, data, size);
+}
+
+// write the payload with the given command and pulse CE to send it.
+uint8_t transmit_payload(uint8_t const cmd, nrf24_mode_t const mode, uint8_t const * const data, uint8_t const size)
+{
 	// write payload command.
-	uint8_t status = spi_out_command(W_TX_PAYLOAD);
-	
 	// now send data, size is 1 to 32 bytes
-	spi_out_data_bytes(data, size);
-
-	// Set CSN high to end command.
-	NRF24_PORT_CSN |= (1 << NRF24_CSN);
+	PROFILE_START(profile_payload_write);
+	uint8_t status = transaction(cmd, data, 0, size);
+	PROFILE_STOP(profile_payload_write);
 
 	// high value represents Standby-II mode.
 	if (NRF24_PORT_CE & (1 << NRF24_CE))
@@ -440,18 +565,41 @@ uint8_t nrf24_transmit_data(nrf24_mode_t const mode, uint8_t const * const data,
 	return status;
 }
 
+// write a payload to the TX FIFO without pulsing CE.
+// with CE held high (Standby-II) the payload is sent as soon as it is loaded.
+uint8_t nrf24_load_payload(uint8_t const * const data, uint8_t const size)
+{
+	// write payload command.
+	// now send data, size is 1 to 32 bytes
+	PROFILE_START(profile_payload_write);
+	uint8_t status = transaction(W_TX_PAYLOAD, data, 0, size);
+	PROFILE_STOP(profile_payload_write);
+
+	return status;
+}
+
+// write a payload to the TX FIFO without pulsing CE or asking for an auto acknowledgment.
+uint8_t nrf24_load_payload_no_ack(uint8_t const * const data, uint8_t const size)
+{
+	PROFILE_START(profile_payload_write);
+	uint8_t status = transaction(W_TX_PAYLOAD_NOACK, data, 0, size);
+	PROFILE_STOP(profile_payload_write);
+
+	return status;
+}
+
+// write a payload to be sent with the next auto acknowledgment on a data pipe (PRX mode).
+uint8_t nrf24_load_ack_payload(uint8_t const pipe, uint8_t const * const data, uint8_t const size)
+{
+	// the data pipe is held in the low 3 bits of the command, size is 1 to 32 bytes.
+	return transaction(W_ACK_PAYLOAD | (pipe & 0x07), data, 0, size);
+}
+
 // send data.
 uint8_t nrf24_retransmit(nrf24_mode_t const mode)
 {
-	// every command must be started by a high to low transition on CSN.
-	// set CSN low to begin command.
-	NRF24_PORT_CSN &= ~(1 << NRF24_CSN);
-
 	// write payload command.
-	uint8_t status = spi_out_command(W_TX_PAYLOAD);
-
-	// Set CSN high to end command.
-	NRF24_PORT_CSN |= (1 << NRF24_CSN);
+	uint8_t status = transaction(W_TX_PAYLOAD, 0, 0, 0);
 
 	// high value represents Standby-II mode.
 	if (NRF24_PORT_CE & (1 << NRF24_CE))
@@ -476,36 +624,16 @@ uint8_t nrf24_retransmit(nrf24_mode_t const mode)
 // get the size of the received payload.
 uint8_t nrf24_get_payload_size(uint8_t * size)
 {
-	uint8_t cmd = R_RX_PL_WID;
-
-	// every command must be started by a high to low transition on CSN.
-	// set CSN low to begin command.
-	NRF24_PORT_CSN &= ~(1 << NRF24_CSN);
-
-	uint8_t status = spi_out_command(cmd);
-	spi_in_data_bytes(size, 1);
-	
-	// Set CSN high to end command.
-	NRF24_PORT_CSN |= (1 << NRF24_CSN);
-	
-	return status;
+	return transaction(R_RX_PL_WID, 0, size, 1);
 }
 
 // get the payload.
 uint8_t nrf24_get_payload(uint8_t * dataptr, uint8_t const size)
 {
-	uint8_t cmd = R_RX_PAYLOAD;
+	PROFILE_START(profile_payload_read);
+	uint8_t status = transaction(R_RX_PAYLOAD, 0, dataptr, size);
+	PROFILE_STOP(profile_payload_read);
 
-	// every command must be started by a high to low transition on CSN.
-	// set CSN low to begin command.
-	NRF24_PORT_CSN &= ~(1 << NRF24_CSN);
-
-	uint8_t status = spi_out_command(cmd);
-	spi_in_data_bytes(dataptr, size);
-		
-	// Set CSN high to end command.
-	NRF24_PORT_CSN |= (1 << NRF24_CSN);
-		
 	return status;
 }
 
@@ -522,64 +650,430 @@ void nrf24_set_ce_high()
 }
 
 
-// write to given register map with given value.
-uint8_t write_register_value(uint8_t const reg_map_addr, uint8_t const data)
+#ifdef NRF24_ASYNC_SPI
+
+// queue of pending transactions, the transaction at the head is in progress.
+static nrf24_transaction_t * volatile m_queue[NRF24_QUEUE_SIZE];
+static volatile uint8_t m_queue_head = 0;
+static volatile uint8_t m_queue_tail = 0;
+
+// index of the byte currently shifting, 0 is the command byte.
+static volatile uint8_t m_byte_index = 0;
+
+// begin the transaction at the head of the queue.
+void start_transaction()
 {
-	// 001AAAAA (where AAAAA is register map address)
-	uint8_t cmd = W_REGISTER | (REGISTER_MASK & reg_map_addr);
+	nrf24_transaction_t * t = m_queue[m_queue_head & (NRF24_QUEUE_SIZE - 1)];
+	m_byte_index = 0;
 
 	// every command must be started by a high to low transition on CSN.
 	// set CSN low to begin command.
 	NRF24_PORT_CSN &= ~(1 << NRF24_CSN);
 
-	uint8_t status = spi_out_command(cmd);
-	spi_out_data_value(data);
-	
+	SPDR = t->cmd;
+}
+
+// called once a byte has finished shifting.
+void transaction_step()
+{
+	nrf24_transaction_t * t = m_queue[m_queue_head & (NRF24_QUEUE_SIZE - 1)];
+	uint8_t index = m_byte_index;
+	uint8_t data = SPDR;
+
+	// the STATUS register is shifted out with the command byte.
+	if (index == 0)
+		t->status = data;
+
+	else if (t->rx != 0)
+		t->rx[index - 1] = data;
+
+	if (index != t->size)
+	{
+		// shift the next byte.
+		SPDR = (t->tx != 0) ? t->tx[index] : RF24_NOP;
+		m_byte_index = index + 1;
+		return;
+	}
+
 	// Set CSN high to end command.
 	NRF24_PORT_CSN |= (1 << NRF24_CSN);
-	
-	return status;
+
+	// retire the transaction and start the next one before the callback, so the callback
+	// may resubmit it or make synchronous nrf24_* calls, which wait behind the queue.
+	t->busy = 0;
+	m_queue_head++;
+
+	if (m_queue_head != m_queue_tail)
+		start_transaction();
+
+	if (t->callback != 0)
+		t->callback(t);
 }
 
-// write to given register map with given value.
-uint8_t write_register_bytes(uint8_t const reg_map_addr, uint8_t const * const data, uint8_t const size)
+ISR(SPI_STC_vect)
 {
-	// 001AAAAA (where AAAAA is register map address)
-	uint8_t cmd = W_REGISTER | (REGISTER_MASK & reg_map_addr);
+	transaction_step();
+}
+
+// advance the queue while interrupts are disabled,
+// either before sei() or from inside another interrupt routine.
+void poll_transaction()
+{
+	if (!(SREG & (1 << SREG_I)) && (SPSR & (1 << SPIF)))
+	{
+		transaction_step();
+	}
+}
+
+// queue a transaction, it will start as soon as the SPI bus is free.
+// returns 0 if the queue is full.
+uint8_t nrf24_submit(nrf24_transaction_t * const transaction)
+{
+	uint8_t queued = 0;
+	uint8_t sreg = SREG;
+	cli();
+
+	if ((uint8_t)(m_queue_tail - m_queue_head) != NRF24_QUEUE_SIZE)
+	{
+		transaction->busy = 1;
+		m_queue[m_queue_tail & (NRF24_QUEUE_SIZE - 1)] = transaction;
+		m_queue_tail++;
+		queued = 1;
+
+		// the bus is idle, start now.
+		if ((uint8_t)(m_queue_tail - m_queue_head) == 1)
+			start_transaction();
+	}
 
+	SREG = sreg;
+	return queued;
+}
+
+// returns 1 while transactions are queued or in progress.
+uint8_t nrf24_busy()
+{
+	return m_queue_head != m_queue_tail;
+}
+
+// run a transaction to completion and return the status byte.
+uint8_t transaction(uint8_t const cmd, uint8_t const * const tx, uint8_t * rx, uint8_t const size)
+{
+	nrf24_transaction_t t;
+	t.cmd = cmd;
+	t.tx = tx;
+	t.rx = rx;
+	t.size = size;
+	t.callback = 0;
+
+	while (!nrf24_submit(&t))
+		poll_transaction();
+
+	while (t.busy)
+		poll_transaction();
+
+	m_status = t.status;
+	return t.status;
+}
+
+#else
+
+// run a transaction to completion and return the status byte.
+uint8_t transaction(uint8_t const cmd, uint8_t const * const tx, uint8_t * rx, uint8_t const size)
+{
 	// every command must be started by a high to low transition on CSN.
 	// set CSN low to begin command.
 	NRF24_PORT_CSN &= ~(1 << NRF24_CSN);
 
 	uint8_t status = spi_out_command(cmd);
-	spi_out_data_bytes(data, size);
-	
+
+	if (tx != 0)
+		spi_out_data_bytes(tx, size);
+
+	else if (rx != 0)
+		spi_in_data_bytes(rx, size);
+
+	// no buffer, clock the bytes out and discard them so a payload read still pops the FIFO.
+	else
+	{
+		for (uint8_t i = 0; i != size; i++)
+			spi_in_data_value();
+	}
+
 	// Set CSN high to end command.
 	NRF24_PORT_CSN |= (1 << NRF24_CSN);
-	
+
+	m_status = status;
+	return status;
+}
+
+#endif /* NRF24_ASYNC_SPI */
+
+#ifdef NRF24_IRQ_ENABLED
+
+#ifdef NRF24_ASYNC_SPI
+
+// STATUS bits to clear once latched.
+static uint8_t m_irq_clear = 0;
+static nrf24_irq_callback_t m_irq_callback = 0;
+
+void irq_status_read(nrf24_transaction_t * transaction);
+void irq_status_cleared(nrf24_transaction_t * transaction);
+
+// NOP command to read STATUS, then a write to clear the bits that were set.
+static nrf24_transaction_t m_irq_read = { RF24_NOP, 0, 0, 0, irq_status_read, 0, 0 };
+static nrf24_transaction_t m_irq_write = { W_REGISTER | RMAP_STATUS, &m_irq_clear, 0, 1, irq_status_cleared, 0, 0 };
+
+// latch the interrupt bits and clear them from the chip, which releases the IRQ line.
+void irq_status_read(nrf24_transaction_t * transaction)
+{
+	uint8_t flags = transaction->status & STATUS_IRQ;
+
+	if (flags != 0)
+	{
+		m_irq_flags |= flags;
+		m_irq_clear |= flags;
+
+		if (!m_irq_write.busy)
+			nrf24_submit(&m_irq_write);
+
+		if (m_irq_callback != 0)
+			m_irq_callback(flags);
+	}
+}
+
+// set the function called from the interrupt when STATUS bits are latched, 0 for none.
+void nrf24_set_irq_callback(nrf24_irq_callback_t callback)
+{
+	m_irq_callback = callback;
+}
+
+// forget latched STATUS bits without an SPI transaction.
+void nrf24_irq_clear(uint8_t const flags)
+{
+	uint8_t sreg = SREG;
+	cli();
+	m_irq_flags &= ~flags;
+	SREG = sreg;
+}
+
+void irq_status_cleared(nrf24_transaction_t * transaction)
+{
+	m_irq_clear = 0;
+}
+
+// queue the STATUS read, if the queue is full nrf24_irq_pending() retries later.
+void irq_service()
+{
+	if (!m_irq_read.busy)
+		nrf24_submit(&m_irq_read);
+}
+
+// returns 1 while an event signalled on the IRQ line has not been cleared from STATUS.
+uint8_t nrf24_irq_pending()
+{
+	// the line is still low, so the routine could not queue its read.
+	if (!(NRF24_PIN_IRQ & (1 << NRF24_IRQ)))
+		irq_service();
+
+	return m_irq_flags != 0 || m_irq_read.busy || m_irq_write.busy;
+}
+
+#else
+
+void irq_service()
+{
+	// the main loop reads STATUS, the interrupt only wakes the MCU.
+}
+
+// returns 1 while an event signalled on the IRQ line has not been cleared from STATUS.
+uint8_t nrf24_irq_pending()
+{
+	// the IRQ line stays low until the STATUS bits are cleared.
+	return !(NRF24_PIN_IRQ & (1 << NRF24_IRQ));
+}
+
+#endif /* NRF24_ASYNC_SPI */
+
+ISR(NRF24_IRQ_vect)
+{
+	// IRQ is active low, ignore the rising edge of a pin change.
+	if (!(NRF24_PIN_IRQ & (1 << NRF24_IRQ)))
+		irq_service();
+}
+
+#endif /* NRF24_IRQ_ENABLED */
+
+// returns the shadow copy of the given register map,
+// or 0 for registers the chip updates itself which must be read live.
+uint8_t * register_shadow(uint8_t const reg_map_addr)
+{
+	switch (reg_map_addr)
+	{
+		case RMAP_STATUS:
+		case RMAP_OBSERVE_TX:
+		case RMAP_CD:
+		case RMAP_FIFO_STATUS:
+			return 0;
+
+		case RMAP_RX_ADDR_P0:
+			return &m_rx_address_p0[0];
+
+		case RMAP_RX_ADDR_P1:
+			return &m_rx_address_p1[0];
+
+		case RMAP_TX_ADDR:
+			return &m_tx_address[0];
+	}
+
+	if (reg_map_addr > RMAP_FEATURE)
+		return 0;
+
+	return &m_registers[reg_map_addr];
+}
+
+// write to given register map with given value.
+uint8_t write_register_value(uint8_t const reg_map_addr, uint8_t const data)
+{
+	return write_register_bytes(reg_map_addr, &data, 1);
+}
+
+// write to given register map with given value.
+uint8_t write_register_bytes(uint8_t const reg_map_addr, uint8_t const * const data, uint8_t const size)
+{
+	// 001AAAAA (where AAAAA is register map address)
+	uint8_t cmd = W_REGISTER | (REGISTER_MASK & reg_map_addr);
+
+	// write through to the shadow copy.
+	uint8_t * shadow = register_shadow(reg_map_addr);
+
+	if (shadow != 0)
+		memcpy(shadow, data, size);
+
+	PROFILE_START(profile_register_write);
+	uint8_t status = transaction(cmd, data, 0, size);
+	PROFILE_STOP(profile_register_write);
+
 	return status;
 }
 
 // read data for given register map.
+// registers held in the shadow copy are served from SRAM, returning the
+// status byte of the most recent transaction rather than a live one.
 uint8_t read_register_bytes(uint8_t const reg_map_addr, uint8_t * dataptr, uint8_t const size)
+{
+	uint8_t * shadow = register_shadow(reg_map_addr);
+
+	if (m_shadow_valid && shadow != 0)
+	{
+		memcpy(dataptr, shadow, size);
+		return m_status;
+	}
+
+	return read_register_live(reg_map_addr, dataptr, size);
+}
+
+// read data for given register map from the chip.
+uint8_t read_register_live(uint8_t const reg_map_addr, uint8_t * dataptr, uint8_t const size)
 {
 	// 001AAAAA (where AAAAA is register map address)
 	uint8_t cmd = R_REGISTER | (REGISTER_MASK & reg_map_addr);
 
-	// every command must be started by a high to low transition on CSN.
-	// set CSN low to begin command.
-	NRF24_PORT_CSN &= ~(1 << NRF24_CSN);
+	PROFILE_START(profile_register_read);
+	uint8_t status = transaction(cmd, 0, dataptr, size);
+	PROFILE_STOP(profile_register_read);
 
-	uint8_t status = spi_out_command(cmd);
-	spi_in_data_bytes(dataptr, size);
-	
-	// Set CSN high to end command.
-	NRF24_PORT_CSN |= (1 << NRF24_CSN);
-	
 	return status;
 }
 
 
+#ifdef NRF24_HARDWARE_SPI
+
+// Hardware SPI transport.
+// -----------------------
+// At F_CPU/2 a byte takes 16 CPU cycles to shift.  The multi-byte functions
+// load the next byte while the current one is shifting so the bus is kept
+// busy between bytes.
+
+// wait for the current byte to finish shifting.
+static inline void spi_wait()
+{
+	while (!(SPSR & (1 << SPIF)));
+}
+
+// send SPI command and return the status byte.
+uint8_t spi_out_command(uint8_t const cmd)
+{
+	// The STATUS register is serially shifted out on the MISO pin simultaneously
+	// to the SPI command word shifting to the MOSI pin.
+	SPDR = cmd;
+	spi_wait();
+
+	return SPDR;
+}
+
+// send a byte of data via SPI.
+void spi_out_data_value(uint8_t const data)
+{
+	SPDR = data;
+	spi_wait();
+}
+
+// send multiple bytes of data via SPI.
+void spi_out_data_bytes(uint8_t const * const data, uint8_t const size)
+{
+	if (size == 0)
+		return;
+
+	SPDR = data[0];
+
+	for (uint8_t i = 1; i != size; i++)
+	{
+		// fetch the next byte while the current byte is shifting.
+		uint8_t next = data[i];
+		spi_wait();
+		SPDR = next;
+	}
+
+	spi_wait();
+}
+
+uint8_t spi_in_data_value()
+{
+	// clock out a NOP to shift in the data byte.
+	SPDR = RF24_NOP;
+	spi_wait();
+
+	return SPDR;
+}
+
+void spi_in_data_bytes(uint8_t * dataptr, uint8_t size)
+{
+	if (size == 0)
+		return;
+
+	uint8_t * ptr = dataptr;
+
+	SPDR = RF24_NOP;
+
+	for (uint8_t i = 1; i != size; i++)
+	{
+		// start the next byte before storing the current one.
+		spi_wait();
+		uint8_t data = SPDR;
+		SPDR = RF24_NOP;
+		*ptr = data;
+		ptr++;
+	}
+
+	spi_wait();
+	*ptr = SPDR;
+}
+
+#else
+
+// Bit-banged SPI transport.
+// -------------------------
+
 // send SPI command and return the status byte.
 uint8_t spi_out_command(uint8_t const cmd)
 {
@@ -702,3 +1196,4 @@ void spi_in_data_bytes(uint8_t * dataptr, uint8_t size)
 	}
 }
 
+#endif /* NRF24_HARDWARE_SPI */
@@ -18,12 +18,138 @@
 #define NRF24_DDR_CSN DDRC
 #define NRF24_CSN PC1
 
+// optional IRQ line (active low).
+// NRF24_IRQ_INT0 uses INT0 on PD2, which the OLED data bus also uses.
+// NRF24_IRQ_PCINT uses a pin change interrupt on the pin below, its vector
+// must not be shared with another pin change routine.
+// leave both commented out to poll the STATUS register instead.
+//#define NRF24_IRQ_INT0
+//#define NRF24_IRQ_PCINT
+#define NRF24_PORT_IRQ PORTB
+#define NRF24_DDR_IRQ DDRB
+#define NRF24_PIN_IRQ PINB
+#define NRF24_IRQ PB6
+#define NRF24_IRQ_PCMSK PCMSK0
+#define NRF24_IRQ_PCIE PCIE0
+#define NRF24_IRQ_vect PCINT0_vect
+
+#if defined(NRF24_IRQ_INT0) || defined(NRF24_IRQ_PCINT)
+#define NRF24_IRQ_ENABLED
+#endif
+
+// SPI transport.
+// NRF24_HARDWARE_SPI uses the ATmega328P SPI peripheral on PB3 (MOSI), PB4 (MISO)
+// and PB5 (SCK), clocked at F_CPU/2.  PB2 (SS) is set as an output so the
+// peripheral stays in master mode.
+// comment out to fall back to the bit-banged transport on the same pins.
+#define NRF24_HARDWARE_SPI
+
+// asynchronous SPI transactions driven by the SPI_STC interrupt (requires NRF24_HARDWARE_SPI).
+// the nrf24_* functions below queue a transaction and wait for it to complete, so they
+// never overlap the caller. nrf24_submit() queues a transaction and returns straight away.
+// NRF24_QUEUE_SIZE is the maximum number of queued transactions (power of 2).
+// at F_CPU/2 a byte shifts in 16 CPU cycles, less than the interrupt's entry and exit,
+// and the nrf24_* functions still wait, so a transaction takes longer than on the polled
+// transport. it only pays when the caller does other work while nrf24_submit() chains run,
+// such as the receive ring, which cgrf_rx_ring_fill() or cgrf_rx_ring_fill_from_irq()
+// then fills from the SPI interrupt.
+// uncomment to use, leave commented out to run every transaction directly on the caller.
+//#define NRF24_ASYNC_SPI
+#define NRF24_QUEUE_SIZE 4
+
+/* Instruction Mnemonics */
+#define R_REGISTER    0x00
+#define W_REGISTER    0x20
+#define REGISTER_MASK 0x1F
+#define ACTIVATE      0x50
+#define R_RX_PL_WID   0x60
+#define R_RX_PAYLOAD  0x61
+#define W_TX_PAYLOAD  0xA0
+#define W_ACK_PAYLOAD 0xA8
+#define W_TX_PAYLOAD_NOACK 0xB0
+#define FLUSH_TX      0xE1
+#define FLUSH_RX      0xE2
+#define REUSE_TX_PL   0xE3
+#define RF24_NOP      0xFF
+
+// Register map table addresses
+// ----------------------------
+// configuration register address.
+// enhanced ShockBurst address.
+// enabled RX addresses.
+// setup of address widths.
+// setup of automatic retransmission
+// RF channel
+// RF setup register
+// status register
+//   (In parallel to the SPI command word applied on the MOSI pin,
+//   the status register is shifted serially out on the MISO pin)
+// transmit observe register
+
+// Register map table
+#define RMAP_CONFIG		 0x00
+#define RMAP_EN_AA       0x01
+#define RMAP_EN_RXADDR   0x02
+#define RMAP_SETUP_AW    0x03
+#define RMAP_SETUP_RETR  0x04
+#define RMAP_RF_CH       0x05
+#define RMAP_RF_SETUP    0x06
+#define RMAP_STATUS		 0x07
+#define RMAP_OBSERVE_TX  0x08
+#define RMAP_CD          0x09
+#define RMAP_RX_ADDR_P0  0x0A
+#define RMAP_RX_ADDR_P1  0x0B
+#define RMAP_RX_ADDR_P2  0x0C
+#define RMAP_RX_ADDR_P3  0x0D
+#define RMAP_RX_ADDR_P4  0x0E
+#define RMAP_RX_ADDR_P5  0x0F
+#define RMAP_TX_ADDR     0x10
+#define RMAP_RX_PW_P0    0x11
+#define RMAP_RX_PW_P1    0x12
+#define RMAP_RX_PW_P2    0x13
+#define RMAP_RX_PW_P3    0x14
+#define RMAP_RX_PW_P4    0x15
+#define RMAP_RX_PW_P5    0x16
+#define RMAP_FIFO_STATUS 0x17
+#define RMAP_DYNPD       0x1C
+#define RMAP_FEATURE     0x1D
+
 typedef enum
 {
 	standby_I_minimise_current,
 	standby_II_fast_start,
 } nrf24_mode_t;
 
+#ifdef NRF24_ASYNC_SPI
+
+typedef struct nrf24_transaction nrf24_transaction_t;
+
+// called from the SPI interrupt when a transaction completes, after the queue has moved on.
+// it may resubmit the transaction or make synchronous nrf24_* calls.
+typedef void (*nrf24_callback_t)(nrf24_transaction_t * transaction);
+
+// SPI transaction descriptor.
+// CSN is held low for the command byte followed by size data bytes.
+// the descriptor and its buffers must stay valid until busy is cleared.
+struct nrf24_transaction
+{
+	uint8_t cmd;				// command byte.
+	uint8_t const * tx;			// data bytes to send, 0 sends NOPs.
+	uint8_t * rx;				// buffer for the bytes received, 0 discards them.
+	uint8_t size;				// number of data bytes after the command.
+	nrf24_callback_t callback;	// completion callback, 0 for none.
+	uint8_t status;				// STATUS register shifted out with the command.
+	volatile uint8_t busy;		// set while queued or in progress.
+};
+
+// queue a transaction, returns 0 if the queue is full.
+uint8_t nrf24_submit(nrf24_transaction_t * const transaction);
+
+// returns 1 while transactions are queued or in progress.
+uint8_t nrf24_busy();
+
+#endif
+
 // configure the nRF24L01+ ports
 void nrf24_configure_ports();
 
@@ -159,22 +285,103 @@ uint8_t nrf24_get_rx_address_pipe1(uint8_t * ptr);
 // set the rx address data pipe 1.
 uint8_t nrf24_set_rx_address_pipe1(uint8_t addr[5]);
 
+// get the rx address data pipe 2, least significant byte.
+uint8_t nrf24_get_rx_address_pipe2(uint8_t * value);
+
+// set the rx address data pipe 2, least significant byte.
+uint8_t nrf24_set_rx_address_pipe2(uint8_t const value);
+
+// get the rx address data pipe 3, least significant byte.
+uint8_t nrf24_get_rx_address_pipe3(uint8_t * value);
+
+// set the rx address data pipe 3, least significant byte.
+uint8_t nrf24_set_rx_address_pipe3(uint8_t const value);
+
+// get the rx address data pipe 4, least significant byte.
+uint8_t nrf24_get_rx_address_pipe4(uint8_t * value);
+
+// set the rx address data pipe 4, least significant byte.
+uint8_t nrf24_set_rx_address_pipe4(uint8_t const value);
+
+// get the rx address data pipe 5, least significant byte.
+uint8_t nrf24_get_rx_address_pipe5(uint8_t * value);
+
+// set the rx address data pipe 5, least significant byte.
+uint8_t nrf24_set_rx_address_pipe5(uint8_t const value);
+
+// get any single byte register value by register map address and return by pointer;
+uint8_t nrf24_get_register(uint8_t const reg_map_addr, uint8_t * value);
+
 // get the carrier detect.
 uint8_t nrf24_get_cd(uint8_t * value);
 
+// Register shadow.
+// configuration registers and addresses are kept in SRAM and written through on every set,
+// so the get functions above only use SPI for STATUS, OBSERVE_TX, CD and FIFO_STATUS.
+// a get served from the shadow returns the status byte of the most recent transaction, which may
+// be stale, use nrf24_get_status() for the current interrupt flags.
+
+// reload the register shadow from the chip.
+// call once the chip is powered, and again after a brown-out or reset of the chip.
+uint8_t nrf24_resync_registers();
+
+// write a register only when the value differs from the shadow copy.
+// returns 1 if the register was written.
+uint8_t nrf24_update_register(uint8_t const reg_map_addr, uint8_t const value);
+
+// write a multi-byte register only when the value differs from the shadow copy.
+// returns 1 if the register was written.
+uint8_t nrf24_update_register_bytes(uint8_t const reg_map_addr, uint8_t const * const data, uint8_t const size);
+
 
 // send data.
 uint8_t nrf24_transmit_data(nrf24_mode_t const mode, uint8_t const * const data, uint8_t const size);
 
+// send data without asking for an auto acknowledgment, needs EN_DYN_ACK in the feature register.
+uint8_t nrf24_transmit_data_no_ack(nrf24_mode_t const mode, uint8_t const * const data, uint8_t const size);
+
+// write a payload to the TX FIFO without pulsing CE.
+uint8_t nrf24_load_payload(uint8_t const * const data, uint8_t const size);
+
+// write a payload to the TX FIFO without pulsing CE or asking for an auto acknowledgment.
+uint8_t nrf24_load_payload_no_ack(uint8_t const * const data, uint8_t const size);
+
+// write a payload to be sent with the next auto acknowledgment on a data pipe (PRX mode).
+uint8_t nrf24_load_ack_payload(uint8_t const pipe, uint8_t const * const data, uint8_t const size);
+
 // resend data.
 uint8_t nrf24_retransmit(nrf24_mode_t const mode);
 
 // get the size of the received payload.
 uint8_t nrf24_get_payload_size(uint8_t * size);
 
-// get the payload.
+// get the payload, a null dataptr reads and discards it.
 uint8_t nrf24_get_payload(uint8_t * dataptr, uint8_t const size);
 
+#ifdef NRF24_IRQ_ENABLED
+
+// returns 1 while an event signalled on the IRQ line has not been cleared from STATUS.
+// with NRF24_ASYNC_SPI the interrupt routine reads and clears STATUS itself, and
+// nrf24_get_status() includes the RX_DR, TX_DS and MAX_RT bits it latched until
+// they are cleared with nrf24_set_status().
+uint8_t nrf24_irq_pending();
+
+#ifdef NRF24_ASYNC_SPI
+
+// called from the interrupt with the STATUS bits it has latched.
+typedef void (*nrf24_irq_callback_t)(uint8_t const flags);
+
+// set the function called from the interrupt when STATUS bits are latched, 0 for none.
+void nrf24_set_irq_callback(nrf24_irq_callback_t callback);
+
+// forget latched STATUS bits without an SPI transaction.
+// for use by interrupt routines that have handled the event.
+void nrf24_irq_clear(uint8_t const flags);
+
+#endif
+
+#endif
+
 void nrf24_set_ce_low();
 void nrf24_set_ce_high();
 
@@ -0,0 +1,129 @@
+/*
+ * profile.c
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Hot path profiler, timer 1 ticks between PROFILE_START and PROFILE_STOP.
+ */
+
+#include "profile.h"
+
+#ifdef PROFILE_ENABLED
+
+#include "debug.h"
+#include <string.h>
+
+static profile_slot_t m_slots[PROFILE_SITES];
+static uint16_t m_overhead = 0;
+
+// six character labels for the dump.
+static char const m_labels[PROFILE_SITES][6] =
+{
+	{ 'R', 'E', 'G', ' ', 'W', ' ' },
+	{ 'R', 'E', 'G', ' ', 'R', ' ' },
+	{ 'P', 'L', ' ', 'W', ' ', ' ' },
+	{ 'P', 'L', ' ', 'R', ' ', ' ' },
+	{ 'R', 'F', ' ', 'T', 'X', ' ' },
+	{ 'R', 'F', ' ', 'R', 'X', ' ' },
+	{ 'O', 'L', 'E', 'D', ' ', 'B' },
+	{ 'O', 'L', 'E', 'D', ' ', 'W' },
+};
+
+// function declarations.
+void dump_value(uint8_t const site, char const * const suffix, uint16_t const value);
+
+// start timer 1 counting CPU cycles unless the ADC is already using it, and clear the slots.
+// call again after adc_stop(), which stops the timer.
+void profile_init()
+{
+	if ((TCCR1B & ((1 << CS12) | (1 << CS11) | (1 << CS10))) == 0)
+	{
+		// normal mode, counting to 0xFFFF at F_CPU.
+		TCCR1A = 0;
+		TCCR1B = (1 << CS10);
+	}
+
+	// an empty site measures the cost of the instrumentation itself.
+	m_overhead = 0;
+	profile_reset();
+
+	PROFILE_START(profile_register_write);
+	PROFILE_STOP(profile_register_write);
+
+	m_overhead = m_slots[profile_register_write].min;
+	profile_reset();
+}
+
+// add the ticks since start to a site, less the cost of the instrumentation.
+void profile_record(profile_site_t const site, uint16_t const start)
+{
+	uint16_t end = TCNT1;
+	uint16_t ticks = end - start;
+
+	// in the ADC's CTC mode the count wraps at OCR1A instead of 0xFFFF.
+	if (end < start && (TCCR1B & (1 << WGM12)))
+		ticks += OCR1A + 1;
+
+	ticks = (ticks > m_overhead) ? ticks - m_overhead : 0;
+
+	profile_slot_t * slot = &m_slots[site];
+
+	if (slot->count == 0 || ticks < slot->min)
+		slot->min = ticks;
+
+	if (ticks > slot->max)
+		slot->max = ticks;
+
+	slot->sum += ticks;
+	slot->count++;
+}
+
+// get the ticks spent in a site.
+void profile_get(profile_site_t const site, profile_slot_t * slot)
+{
+	*slot = m_slots[site];
+}
+
+// clear the slots.
+void profile_reset()
+{
+	memset(m_slots, 0, sizeof(m_slots));
+}
+
+// show the count, minimum, maximum and average ticks of each site that has run.
+void profile_dump()
+{
+	// the display writes are themselves instrumented, so work from a copy.
+	profile_slot_t slots[PROFILE_SITES];
+	memcpy(slots, m_slots, sizeof(slots));
+
+	for (uint8_t site = 0; site != PROFILE_SITES; site++)
+	{
+		profile_slot_t const * slot = &slots[site];
+
+		if (slot->count == 0)
+			continue;
+
+		dump_value(site, " CNT", slot->count);
+		dump_value(site, " MIN", slot->min);
+		dump_value(site, " MAX", slot->max);
+		dump_value(site, " AVG", slot->sum / slot->count);
+	}
+}
+
+// private functions...
+//
+
+// show a value under the site's label and a four character suffix.
+void dump_value(uint8_t const site, char const * const suffix, uint16_t const value)
+{
+	char text[10];
+
+	memcpy(&text[0], m_labels[site], 6);
+	memcpy(&text[6], suffix, 4);
+
+	display_counter(&text[0], 10, value);
+}
+
+#endif /* PROFILE_ENABLED */
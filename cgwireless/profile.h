@@ -0,0 +1,75 @@
+/*
+ * profile.h
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Hot path profiler, timer 1 ticks between PROFILE_START and PROFILE_STOP.
+ */
+
+#include <stdint.h>
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+// time the instrumented hot paths with timer 1.
+// uncomment to build the PROFILE_START and PROFILE_STOP points in, they compile to nothing otherwise.
+//#define PROFILE_ENABLED
+
+// instrumented sites.
+typedef enum
+{
+	profile_register_write,		// nrf24l01.c
+	profile_register_read,
+	profile_payload_write,
+	profile_payload_read,
+	profile_rf_send,			// cgrf.c
+	profile_rf_receive,
+	profile_oled_busy_wait,		// cgoled.c
+	profile_oled_write_data,
+} profile_site_t;
+
+#define PROFILE_SITES 8
+
+// ticks spent in a site.
+typedef struct
+{
+	uint16_t count;
+	uint16_t min;
+	uint16_t max;
+	uint32_t sum;
+} profile_slot_t;
+
+#ifdef PROFILE_ENABLED
+
+#include <avr/io.h>
+
+// a tick is one CPU cycle when profile_init() starts timer 1, and the ADC's prescaler while it is sampling.
+// interrupts taken between the two points are included, and a site must be shorter than the timer's period.
+#define PROFILE_START(site) uint16_t const profile_start_##site = TCNT1
+#define PROFILE_STOP(site) profile_record(site, profile_start_##site)
+
+// start timer 1 counting CPU cycles unless the ADC is already using it, and clear the slots.
+// call again after adc_stop(), which stops the timer.
+void profile_init();
+
+// add the ticks since start to a site, less the cost of the instrumentation.
+void profile_record(profile_site_t const site, uint16_t const start);
+
+// get the ticks spent in a site.
+void profile_get(profile_site_t const site, profile_slot_t * slot);
+
+// clear the slots.
+void profile_reset();
+
+// show the count, minimum, maximum and average ticks of each site that has run.
+void profile_dump();
+
+#else
+
+#define PROFILE_START(site)
+#define PROFILE_STOP(site)
+
+#endif /* PROFILE_ENABLED */
+
+#endif /* PROFILE_H_ */
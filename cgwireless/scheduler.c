@@ -0,0 +1,250 @@
+/*
+ * scheduler.c
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Periodic tasks, sleeping between their deadlines.
+ */
+
+#include "scheduler.h"
+#include "clock.h"
+#include "nrf24l01.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+
+// the watchdog oscillator is only accurate to about 10%, so a watchdog sleep must end this much early.
+#define WATCHDOG_MARGIN(ms)	((ms) / 8)
+
+// longest watchdog period, WDP2:0 of 7 is 2048 ms.
+#define WATCHDOG_MAX_WDP	7
+
+typedef struct
+{
+	scheduler_task_t task;
+	uint16_t period;
+	uint32_t last;			// the deadline the task last ran for.
+} scheduler_entry_t;
+
+static scheduler_entry_t m_tasks[SCHEDULER_MAX_TASKS];
+static uint8_t m_power_save = 0;
+static volatile uint8_t m_watchdog_woke = 0;
+static scheduler_check_t m_wake_check = 0;
+
+// function declarations.
+uint16_t next_deadline();
+uint8_t stay_awake();
+void sleep_idle(uint8_t const check);
+void sleep_watchdog(uint16_t const ms);
+
+// routine for the watchdog interrupt, it only wakes the MCU.
+ISR(WDT_vect)
+{
+	m_watchdog_woke = 1;
+}
+
+// add a task run every period milliseconds, the first run is one period from now.
+// requires clock_init(), returns 0 if there is no room.
+uint8_t scheduler_add(scheduler_task_t task, uint16_t const period_ms)
+{
+	if (task == 0 || period_ms == 0)
+		return 0;
+
+	for (uint8_t i = 0; i < SCHEDULER_MAX_TASKS; i++)
+	{
+		if (m_tasks[i].task == 0)
+		{
+			m_tasks[i].task = task;
+			m_tasks[i].period = period_ms;
+			m_tasks[i].last = clock_millis();
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// remove a task.
+void scheduler_remove(scheduler_task_t task)
+{
+	for (uint8_t i = 0; i < SCHEDULER_MAX_TASKS; i++)
+	{
+		if (m_tasks[i].task == task)
+			m_tasks[i].task = 0;
+	}
+}
+
+// allow long waits to be slept in the power save mode, woken by the watchdog.
+// timer 2, timer 1 and SPI stop, so only allow it while the ADC is not sampling, and with the radio
+// IRQ on a pin change interrupt, an INT0 edge does not wake the power save mode.
+// the clock loses the rest of a watchdog period when another interrupt wakes the MCU early.
+void scheduler_allow_power_save(uint8_t const allow)
+{
+	m_power_save = allow;
+}
+
+// set the function checked with interrupts disabled just before sleeping, 0 for none.
+// scheduler_run() returns without sleeping while it returns non-zero.
+void scheduler_set_wake_check(scheduler_check_t check)
+{
+	m_wake_check = check;
+}
+
+// run the tasks that are due, then sleep until the next deadline or an interrupt.
+// call from the main loop.
+void scheduler_run()
+{
+	uint32_t now = clock_millis();
+
+	for (uint8_t i = 0; i < SCHEDULER_MAX_TASKS; i++)
+	{
+		scheduler_entry_t * entry = &m_tasks[i];
+
+		if (entry->task == 0 || now - entry->last < entry->period)
+			continue;
+
+		// the next deadline follows on from this one so the period does not drift,
+		// a task more than a period late starts again from now rather than running to catch up.
+		entry->last += entry->period;
+
+		if (now - entry->last >= entry->period)
+			entry->last = now;
+
+		entry->task();
+	}
+
+	uint16_t wait = next_deadline();
+
+	if (wait == 0)
+		return;
+
+#ifndef NRF24_IRQ_INT0
+	if (m_power_save && wait >= SCHEDULER_WATCHDOG_MIN_MS + WATCHDOG_MARGIN(wait))
+	{
+#ifdef NRF24_ASYNC_SPI
+		// the SPI clock stops in the power save mode.
+		if (!nrf24_busy())
+#endif
+		{
+			sleep_watchdog(wait - WATCHDOG_MARGIN(wait));
+			return;
+		}
+	}
+#endif
+
+	// the timer 2 tick wakes the idle mode every millisecond.
+	sleep_idle(1);
+}
+
+// sleep in the idle mode for the given milliseconds, interrupts are still serviced.
+// requires clock_init().
+void scheduler_sleep_ms(uint16_t const ms)
+{
+	uint32_t start = clock_millis();
+
+	while (clock_elapsed(start) < ms)
+		sleep_idle(0);
+}
+
+// private functions...
+//
+
+// milliseconds to the earliest deadline, 0 if a task is due.
+uint16_t next_deadline()
+{
+	uint32_t now = clock_millis();
+	uint16_t wait = 0xFFFF;
+
+	for (uint8_t i = 0; i < SCHEDULER_MAX_TASKS; i++)
+	{
+		scheduler_entry_t * entry = &m_tasks[i];
+
+		if (entry->task == 0)
+			continue;
+
+		uint32_t elapsed = now - entry->last;
+
+		if (elapsed >= entry->period)
+			return 0;
+
+		if (entry->period - elapsed < wait)
+			wait = entry->period - elapsed;
+	}
+
+	return wait;
+}
+
+// returns 1 if the wake check has work waiting, called with interrupts disabled.
+uint8_t stay_awake()
+{
+	return m_wake_check != 0 && m_wake_check();
+}
+
+// idle until the next interrupt, unless check is set and the wake check has work waiting.
+void sleep_idle(uint8_t const check)
+{
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	cli();
+
+	if (check && stay_awake())
+	{
+		sei();
+		return;
+	}
+
+	// sleep executes before any interrupt after sei.
+	sleep_enable();
+	sei();
+	sleep_cpu();
+	sleep_disable();
+}
+
+// sleep in the power save mode for the longest watchdog period that fits in ms,
+// unless the wake check has work waiting.
+void sleep_watchdog(uint16_t const ms)
+{
+	uint8_t wdp = 0;
+	uint16_t period = SCHEDULER_WATCHDOG_MIN_MS;
+
+	while (wdp < WATCHDOG_MAX_WDP && (period << 1) <= ms)
+	{
+		wdp++;
+		period <<= 1;
+	}
+
+	cli();
+
+	if (stay_awake())
+	{
+		sei();
+		return;
+	}
+
+	m_watchdog_woke = 0;
+
+	// the watchdog interrupt without a reset, changed inside the timed sequence.
+	wdt_reset();
+	WDTCSR = (1 << WDCE) | (1 << WDE);
+	WDTCSR = (1 << WDIE) | wdp;
+
+	set_sleep_mode(SLEEP_MODE_PWR_SAVE);
+	sleep_enable();
+	sei();
+	sleep_cpu();
+	sleep_disable();
+
+	cli();
+	wdt_reset();
+	MCUSR &= ~(1 << WDRF);
+	WDTCSR = (1 << WDCE) | (1 << WDE);
+	WDTCSR = 0;
+
+	// timer 2 stopped while asleep.
+	if (m_watchdog_woke)
+		clock_advance(period);
+
+	sei();
+}
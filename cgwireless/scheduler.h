@@ -0,0 +1,51 @@
+/*
+ * scheduler.h
+ *
+ * Created: 16-10-2026
+ * Author:  agent
+ *
+ * Periodic tasks, sleeping between their deadlines.
+ */
+
+#include <stdint.h>
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+// largest number of tasks.
+#define SCHEDULER_MAX_TASKS 6
+
+// shortest watchdog sleep, the power save mode is only used for waits at least this long.
+#define SCHEDULER_WATCHDOG_MIN_MS 16
+
+typedef void (*scheduler_task_t)();
+
+// returns non-zero while there is work waiting that an interrupt has signalled.
+typedef uint8_t (*scheduler_check_t)();
+
+// add a task run every period milliseconds, the first run is one period from now.
+// requires clock_init(), returns 0 if there is no room.
+uint8_t scheduler_add(scheduler_task_t task, uint16_t const period_ms);
+
+// remove a task.
+void scheduler_remove(scheduler_task_t task);
+
+// allow long waits to be slept in the power save mode, woken by the watchdog.
+// timer 2, timer 1 and SPI stop, so only allow it while the ADC is not sampling, and with the radio
+// IRQ on a pin change interrupt, an INT0 edge does not wake the power save mode.
+// the clock loses the rest of a watchdog period when another interrupt wakes the MCU early.
+void scheduler_allow_power_save(uint8_t const allow);
+
+// set the function checked with interrupts disabled just before sleeping, 0 for none.
+// scheduler_run() returns without sleeping while it returns non-zero.
+void scheduler_set_wake_check(scheduler_check_t check);
+
+// run the tasks that are due, then sleep until the next deadline or an interrupt.
+// call from the main loop.
+void scheduler_run();
+
+// sleep in the idle mode for the given milliseconds, interrupts are still serviced.
+// requires clock_init().
+void scheduler_sleep_ms(uint16_t const ms);
+
+#endif /* SCHEDULER_H_ */